@@ -0,0 +1,384 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesInterface.h"
+#include "FlakesLogging.h"
+#include "FlakesModule.h"
+#include "FlakesSnapshot.h"
+#include "Async/Async.h"
+#include "Providers/FlakesFastBinarySerializer.h"
+#include "Providers/FlakesPodSerializer.h"
+
+namespace Flakes
+{
+	namespace Private
+	{
+		// Everything a read task needs, shared between its background and game thread steps. Raw may point into Flake,
+		// so the state is kept in one place instead of being moved between tasks.
+		struct FAsyncWriteState
+		{
+			FFlake Flake;
+			FWriteOptions Options;
+			TArray<uint8> Buffer;
+			TConstArrayView<uint8> Raw;
+			bool Decompressed = false;
+		};
+
+		bool IsProviderThreadSafe(const FName Serializer)
+		{
+			bool ThreadSafe = false;
+			FFlakesModule::Get().UseSerializationProvider(Serializer,
+				[&](const ISerializationProvider* Provider)
+				{
+					ThreadSafe = Provider->IsThreadSafe();
+				});
+			return ThreadSafe;
+		}
+
+		UE::Tasks::TTask<FFlake> LaunchCompress(FFlake&& Flake, TArray<uint8>&& Raw, const bool Text, const FReadOptions& Options)
+		{
+			return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+				[Flake = MoveTemp(Flake), Raw = MoveTemp(Raw), Text, Options]() mutable
+				{
+#if WITH_EDITOR
+					Flake.DebugString = MakeDebugString(Raw, Text);
+#endif
+
+					(void)CompressFlake(Flake, MoveTemp(Raw), Options);
+					return MoveTemp(Flake);
+				});
+		}
+
+		UE::Tasks::FTask LaunchDecompress(const TSharedRef<FAsyncWriteState>& State)
+		{
+			return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+				[State]
+				{
+					State->Decompressed = DecompressFlake(State->Flake, State->Buffer, State->Raw, State->Options);
+				});
+		}
+
+		TSharedRef<FAsyncWriteState> MakeWriteState(const FFlake& Flake, const FWriteOptions& Options)
+		{
+			TSharedRef<FAsyncWriteState> State = MakeShared<FAsyncWriteState>();
+			State->Flake = Flake;
+			State->Options = Options;
+			return State;
+		}
+	}
+
+	UE::Tasks::TTask<FFlake> MakeFlakeAsync(const FName Serializer, const FConstStructView& Struct, const UObject* Outer, const FReadOptions& Options)
+	{
+		check(IsInGameThread());
+
+		FFlake Flake;
+		Flake.Struct = Struct.GetScriptStruct();
+		Flake.Header.Provider = Serializer;
+
+		if (Struct.IsValid() &&
+			Private::CanSerializeOffGameThread(Struct.GetScriptStruct()) &&
+			Private::IsProviderThreadSafe(Serializer))
+		{
+			// Snapshot the struct, so the caller is free to modify theirs while it's serialized. The outer isn't passed
+			// along, as a struct without object references has no use for it.
+			FInstancedStruct Snapshot;
+			Snapshot.InitializeAs(Struct.GetScriptStruct(), Struct.GetMemory());
+
+			return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+				[Serializer, Flake = MoveTemp(Flake), Snapshot = MoveTemp(Snapshot), Options]() mutable
+				{
+					TArray<uint8> Raw;
+					bool Text = false;
+					if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+						[&](ISerializationProvider* Provider)
+						{
+							Provider->Virtual_ReadData(FConstStructView(Snapshot), Raw);
+							Text = Provider->IsText();
+						}))
+					{
+						UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+						return FFlake();
+					}
+
+#if WITH_EDITOR
+					Flake.DebugString = Private::MakeDebugString(Raw, Text);
+#endif
+
+					(void)Private::CompressFlake(Flake, MoveTemp(Raw), Options);
+					return MoveTemp(Flake);
+				});
+		}
+
+		TArray<uint8> Raw;
+		bool Text = false;
+
+		if (Struct.IsValid())
+		{
+			if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+				[&](ISerializationProvider* Provider)
+				{
+					Provider->Virtual_ReadData(Struct, Raw, Outer);
+					Text = Provider->IsText();
+				}))
+			{
+				UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+				return UE::Tasks::MakeCompletedTask<FFlake>();
+			}
+		}
+
+		return Private::LaunchCompress(MoveTemp(Flake), MoveTemp(Raw), Text, Options);
+	}
+
+	UE::Tasks::TTask<FFlake> MakeFlakeAsync(const FName Serializer, const UObject* Object, const FReadOptions& Options)
+	{
+		check(IsInGameThread());
+		check(Object && !Object->IsA<AActor>());
+
+		FFlake Flake;
+		Flake.Struct = Object->GetClass();
+		Flake.Header.Provider = Serializer;
+
+		// Pod writes objects as FastBinary payloads, behind a mode byte.
+		const bool IsPod = Serializer == Pod::Type::ProviderName;
+		if (IsPod || Serializer == FastBinary::Type::ProviderName)
+		{
+			// Only the property values are copied here. Plans can run on the copies, so encoding and compression both
+			// happen in the background.
+			TSharedPtr<Private::FObjectSnapshot> Snapshot = MakeShared<Private::FObjectSnapshot>(Object);
+
+			return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+				[Flake = MoveTemp(Flake), Snapshot = MoveTemp(Snapshot), IsPod, Options]() mutable
+				{
+					TArray<uint8> Raw;
+					if (IsPod)
+					{
+						Raw.Add(Pod::FastBinaryMode);
+					}
+					Snapshot->Encode(Raw);
+
+					// The snapshot references UObjects, and so is released on the game thread.
+					AsyncTask(ENamedThreads::GameThread, [Snapshot = MoveTemp(Snapshot)] {});
+
+#if WITH_EDITOR
+					Flake.DebugString = Private::MakeDebugString(Raw, false);
+#endif
+
+					(void)Private::CompressFlake(Flake, MoveTemp(Raw), Options);
+					return MoveTemp(Flake);
+				});
+		}
+
+		// Other providers serialize through the live object. Binary and NetBinary run UObject::Serialize, which any class
+		// can override to write more than its properties, so a copy of the properties can't stand in for it. These are
+		// serialized right away, and only compression is deferred.
+		TArray<uint8> Raw;
+		bool Text = false;
+
+		if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+			[&](ISerializationProvider* Provider)
+			{
+				Provider->Virtual_ReadData(Object, Raw);
+				Text = Provider->IsText();
+			}))
+		{
+			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+			return UE::Tasks::MakeCompletedTask<FFlake>();
+		}
+
+		return Private::LaunchCompress(MoveTemp(Flake), MoveTemp(Raw), Text, Options);
+	}
+
+	UE::Tasks::TTask<FInstancedStruct> CreateStructAsync(const FName Serializer, const FFlake& Flake, const UScriptStruct* ExpectedStruct, const FWriteOptions& Options, UObject* Outer)
+	{
+		check(IsInGameThread());
+
+		Private::VerifyProvider(Flake, Serializer);
+
+		// Resolving the type may load it, so this has to happen here.
+		UStruct* Struct = nullptr;
+		if (!Private::VerifyStruct(Flake, ExpectedStruct, Struct)) return UE::Tasks::MakeCompletedTask<FInstancedStruct>();
+
+		const UScriptStruct* ScriptStruct = Cast<UScriptStruct>(Struct);
+		const TSharedRef<Private::FAsyncWriteState> State = Private::MakeWriteState(Flake, Options);
+		const UE::Tasks::FTask Decompress = Private::LaunchDecompress(State);
+
+		if (Private::CanSerializeOffGameThread(ScriptStruct) && Private::IsProviderThreadSafe(Serializer))
+		{
+			UE::Tasks::TTask<FInstancedStruct> Write = UE::Tasks::Launch(UE_SOURCE_LOCATION,
+				[Serializer, State, ScriptStruct]
+				{
+					FInstancedStruct CreatedStruct;
+
+					if (!State->Decompressed)
+					{
+						return CreatedStruct;
+					}
+
+					CreatedStruct.InitializeAs(ScriptStruct);
+
+					// The provider was found on the game thread, but may have been removed since.
+					if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+						[&](ISerializationProvider* Provider)
+						{
+							Provider->Virtual_WriteData(FStructView(CreatedStruct), State->Raw);
+						}))
+					{
+						UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+						return FInstancedStruct();
+					}
+
+					return CreatedStruct;
+				},
+				UE::Tasks::Prerequisites(Decompress));
+
+			if (!Options.ExecPostLoadOrPostScriptConstruct)
+			{
+				return Write;
+			}
+
+			// PostScriptConstruct is user code, and may touch UObjects, so it's run back on the game thread.
+			return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+				[Write]() mutable
+				{
+					FInstancedStruct CreatedStruct = MoveTemp(Write.GetResult());
+					if (CreatedStruct.IsValid())
+					{
+						Private::PostLoadStruct(FStructView(CreatedStruct));
+					}
+					return CreatedStruct;
+				},
+				UE::Tasks::Prerequisites(Write),
+				UE::Tasks::ETaskPriority::Normal, UE::Tasks::EExtendedTaskPriority::GameThreadNormalPri);
+		}
+
+		return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+			[Serializer, State, ScriptStruct, WeakOuter = TWeakObjectPtr<UObject>(Outer)]
+			{
+				FInstancedStruct CreatedStruct;
+
+				if (!State->Decompressed)
+				{
+					return CreatedStruct;
+				}
+
+				CreatedStruct.InitializeAs(ScriptStruct);
+
+				if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+					[&](ISerializationProvider* Provider)
+					{
+						Provider->Virtual_WriteData(FStructView(CreatedStruct), State->Raw, WeakOuter.Get());
+					}))
+				{
+					UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+					return FInstancedStruct();
+				}
+
+				if (State->Options.ExecPostLoadOrPostScriptConstruct)
+				{
+					Private::PostLoadStruct(FStructView(CreatedStruct));
+				}
+
+				return CreatedStruct;
+			},
+			UE::Tasks::Prerequisites(Decompress),
+			UE::Tasks::ETaskPriority::Normal, UE::Tasks::EExtendedTaskPriority::GameThreadNormalPri);
+	}
+
+	UE::Tasks::TTask<bool> WriteObjectAsync(const FName Serializer, UObject* Object, const FFlake& Flake, const FWriteOptions& Options)
+	{
+		check(IsInGameThread());
+
+		Private::VerifyProvider(Flake, Serializer);
+
+		const TSharedRef<Private::FAsyncWriteState> State = Private::MakeWriteState(Flake, Options);
+		const UE::Tasks::FTask Decompress = Private::LaunchDecompress(State);
+
+		return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+			[Serializer, State, WeakObject = TWeakObjectPtr<UObject>(Object)]
+			{
+				// The object may have been destroyed while the flake was decompressing.
+				UObject* Object = WeakObject.Get();
+				if (!Object || !State->Decompressed)
+				{
+					return false;
+				}
+
+				Private::FCreatedObjectsScope CreatedObjects(State->Options);
+				if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+					[&](ISerializationProvider* Provider)
+					{
+						Provider->Virtual_WriteData(Object, State->Raw);
+					}))
+				{
+					UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+					return false;
+				}
+
+				CreatedObjects.ReleaseStaleSubobjects(State->Options.ObjectPool);
+
+				if (State->Options.ExecPostLoadOrPostScriptConstruct)
+				{
+					Private::PostLoadUObject(Object, CreatedObjects.GetCreatedObjects());
+				}
+
+				return true;
+			},
+			UE::Tasks::Prerequisites(Decompress),
+			UE::Tasks::ETaskPriority::Normal, UE::Tasks::EExtendedTaskPriority::GameThreadNormalPri);
+	}
+
+	UE::Tasks::TTask<TStrongObjectPtr<UObject>> CreateObjectAsync(const FName Serializer, const FFlake& Flake, UObject* Outer, const UClass* ExpectedClass, const FWriteOptions& Options)
+	{
+		check(IsInGameThread());
+
+		Private::VerifyProvider(Flake, Serializer);
+
+		UStruct* Struct = nullptr;
+		if (!Private::VerifyStruct(Flake, ExpectedClass, Struct)) return UE::Tasks::MakeCompletedTask<TStrongObjectPtr<UObject>>();
+
+		const UClass* ObjClass = Cast<UClass>(Struct);
+
+		// Unlikely because we already called VerifyStruct
+		if (UNLIKELY(!IsValid(ObjClass)))
+		{
+			return UE::Tasks::MakeCompletedTask<TStrongObjectPtr<UObject>>();
+		}
+
+		const TSharedRef<Private::FAsyncWriteState> State = Private::MakeWriteState(Flake, Options);
+		const UE::Tasks::FTask Decompress = Private::LaunchDecompress(State);
+
+		return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+			[Serializer, State, ObjClass, WeakOuter = TWeakObjectPtr<UObject>(Outer)]() -> TStrongObjectPtr<UObject>
+			{
+				UObject* Outer = WeakOuter.Get();
+				if (!Outer || !State->Decompressed)
+				{
+					return nullptr;
+				}
+
+				// Nothing else references the object until the caller takes it from the task, so it's held from here.
+				TStrongObjectPtr<UObject> LoadedObject(Private::NewOrPooledObject(Outer, ObjClass, State->Options));
+
+				Private::FCreatedObjectsScope CreatedObjects(State->Options);
+				if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+					[&](ISerializationProvider* Provider)
+					{
+						Provider->Virtual_WriteData(LoadedObject.Get(), State->Raw);
+					}))
+				{
+					UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+					return LoadedObject;
+				}
+
+				CreatedObjects.ReleaseStaleSubobjects(State->Options.ObjectPool);
+
+				if (State->Options.ExecPostLoadOrPostScriptConstruct)
+				{
+					Private::PostLoadUObject(LoadedObject.Get(), CreatedObjects.GetCreatedObjects());
+				}
+
+				return LoadedObject;
+			},
+			UE::Tasks::Prerequisites(Decompress),
+			UE::Tasks::ETaskPriority::Normal, UE::Tasks::EExtendedTaskPriority::GameThreadNormalPri);
+	}
+}
\ No newline at end of file
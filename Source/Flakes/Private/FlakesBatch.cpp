@@ -0,0 +1,305 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesInterface.h"
+#include "FlakesLogging.h"
+#include "FlakesModule.h"
+
+#include "Algo/AllOf.h"
+#include "Async/ParallelFor.h"
+
+#include <atomic>
+
+namespace Flakes
+{
+	namespace Private
+	{
+		// Location of one provider payload inside a batch's scratch buffer.
+		struct FBatchSlice
+		{
+			int32 Offset = 0;
+			int32 Num = 0;
+		};
+
+		struct FBatchScratch
+		{
+			TArray<uint8> Buffer;
+		};
+
+		// Compresses each payload in the scratch buffer into its flake on worker threads.
+		void CompressBatch(TArray<FFlake>& Flakes, const TArray<uint8>& Scratch, const TArray<FBatchSlice>& Slices, const bool Text, const FReadOptions& Options)
+		{
+			ParallelFor(Flakes.Num(),
+				[&](const int32 Index)
+				{
+					const TConstArrayView<uint8> Raw(Scratch.GetData() + Slices[Index].Offset, Slices[Index].Num);
+
+#if WITH_EDITOR
+					Flakes[Index].DebugString = MakeDebugString(Raw, Text);
+#endif
+
+					(void)CompressFlake(Flakes[Index], Raw, Options);
+				});
+		}
+
+		// Decompresses every flake on worker threads. Views in OutRaw point into either the flakes or the buffers, and are
+		// only usable where OutValid is set.
+		bool DecompressBatch(const TConstArrayView<FFlake> Flakes, TArray<TArray<uint8>>& Buffers,
+			TArray<TConstArrayView<uint8>>& OutRaw, TArray<bool>& OutValid, const FWriteOptions& Options)
+		{
+			Buffers.SetNum(Flakes.Num());
+			OutRaw.SetNum(Flakes.Num());
+			OutValid.SetNumZeroed(Flakes.Num());
+
+			std::atomic<bool> Success = true;
+			ParallelFor(Flakes.Num(),
+				[&](const int32 Index)
+				{
+					OutValid[Index] = DecompressFlake(Flakes[Index], Buffers[Index], OutRaw[Index], Options);
+					if (!OutValid[Index])
+					{
+						Success = false;
+					}
+				});
+
+			return Success;
+		}
+	}
+
+	TArray<FFlake> MakeFlakes(const FName Serializer, const TConstArrayView<FConstStructView> Structs, const UObject* Outer, const FReadOptions& Options)
+	{
+		TArray<FFlake> Flakes;
+		Flakes.SetNum(Structs.Num());
+
+		if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+			[&](ISerializationProvider* Provider)
+			{
+				const bool Parallel = Provider->IsThreadSafe() &&
+					Algo::AllOf(Structs, [](const FConstStructView& Struct)
+						{
+							return !Struct.IsValid() || Private::CanSerializeOffGameThread(Struct.GetScriptStruct());
+						});
+
+				if (Parallel)
+				{
+					// Each worker reuses its own scratch buffer, and serializes, then compresses, its share of the structs.
+					TArray<Private::FBatchScratch> Contexts;
+					ParallelForWithTaskContext(Contexts, Structs.Num(),
+						[&](Private::FBatchScratch& Scratch, const int32 Index)
+						{
+							FFlake& Flake = Flakes[Index];
+							Flake.Struct = Structs[Index].GetScriptStruct();
+							Flake.Header.Provider = Serializer;
+
+							Scratch.Buffer.Reset();
+							if (Structs[Index].IsValid())
+							{
+								Provider->Virtual_ReadData(Structs[Index], Scratch.Buffer, Outer);
+							}
+
+#if WITH_EDITOR
+							Flake.DebugString = Private::MakeDebugString(Scratch.Buffer, Provider->IsText());
+#endif
+
+							(void)Private::CompressFlake(Flake, TConstArrayView<uint8>(Scratch.Buffer), Options);
+						});
+					return;
+				}
+
+				// Serialize every struct into one buffer on this thread, then compress in parallel.
+				TArray<uint8> Scratch;
+				TArray<Private::FBatchSlice> Slices;
+				Slices.SetNum(Structs.Num());
+
+				for (int32 Index = 0; Index < Structs.Num(); ++Index)
+				{
+					Flakes[Index].Struct = Structs[Index].GetScriptStruct();
+					Flakes[Index].Header.Provider = Serializer;
+
+					Slices[Index].Offset = Scratch.Num();
+					if (Structs[Index].IsValid())
+					{
+						Provider->Virtual_ReadData(Structs[Index], Scratch, Outer);
+					}
+					Slices[Index].Num = Scratch.Num() - Slices[Index].Offset;
+				}
+
+				Private::CompressBatch(Flakes, Scratch, Slices, Provider->IsText(), Options);
+			}))
+		{
+			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+			return {};
+		}
+
+		return Flakes;
+	}
+
+	TArray<FFlake> MakeFlakes(const FName Serializer, const TConstArrayView<const UObject*> Objects, const FReadOptions& Options)
+	{
+		TArray<FFlake> Flakes;
+		Flakes.SetNum(Objects.Num());
+
+		if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+			[&](ISerializationProvider* Provider)
+			{
+				// Objects have to be serialized on the game thread, but the payloads are still packed into one buffer.
+				TArray<uint8> Scratch;
+				TArray<Private::FBatchSlice> Slices;
+				Slices.SetNum(Objects.Num());
+
+				for (int32 Index = 0; Index < Objects.Num(); ++Index)
+				{
+					const UObject* Object = Objects[Index];
+					check(Object && !Object->IsA<AActor>());
+
+					Flakes[Index].Struct = Object->GetClass();
+					Flakes[Index].Header.Provider = Serializer;
+
+					Slices[Index].Offset = Scratch.Num();
+					Provider->Virtual_ReadData(Object, Scratch);
+					Slices[Index].Num = Scratch.Num() - Slices[Index].Offset;
+				}
+
+				Private::CompressBatch(Flakes, Scratch, Slices, Provider->IsText(), Options);
+			}))
+		{
+			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+			return {};
+		}
+
+		return Flakes;
+	}
+
+	TArray<FInstancedStruct> CreateStructs(const FName Serializer, const TConstArrayView<FFlake> Flakes, const UScriptStruct* ExpectedStruct, const FWriteOptions& Options, UObject* Outer)
+	{
+		TArray<FInstancedStruct> Structs;
+		Structs.SetNum(Flakes.Num());
+
+		// Struct types have to be resolved on the game thread, as they may need to be loaded.
+		bool AllOffGameThread = true;
+		for (int32 Index = 0; Index < Flakes.Num(); ++Index)
+		{
+			Private::VerifyProvider(Flakes[Index], Serializer);
+
+			UStruct* Struct = nullptr;
+			if (Private::VerifyStruct(Flakes[Index], ExpectedStruct, Struct))
+			{
+				Structs[Index].InitializeAs(Cast<UScriptStruct>(Struct));
+				AllOffGameThread &= Private::CanSerializeOffGameThread(Cast<UScriptStruct>(Struct));
+			}
+		}
+
+		TArray<TArray<uint8>> Buffers;
+		TArray<TConstArrayView<uint8>> Raw;
+		TArray<bool> Valid;
+		if (!Private::DecompressBatch(Flakes, Buffers, Raw, Valid, Options))
+		{
+			UE_LOG(LogFlakes, Error, TEXT("CreateStructs: Failed to decompress one or more flakes"))
+		}
+
+		if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+			[&](ISerializationProvider* Provider)
+			{
+				auto Write = [&](const int32 Index)
+					{
+						// Skip flakes that failed to verify, or decompress.
+						if (Structs[Index].IsValid() && Valid[Index])
+						{
+							Provider->Virtual_WriteData(FStructView(Structs[Index]), Raw[Index], Outer);
+						}
+					};
+
+				if (Provider->IsThreadSafe() && AllOffGameThread)
+				{
+					ParallelFor(Structs.Num(), Write);
+				}
+				else
+				{
+					for (int32 Index = 0; Index < Structs.Num(); ++Index)
+					{
+						Write(Index);
+					}
+				}
+			}))
+		{
+			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+			return {};
+		}
+
+		if (Options.ExecPostLoadOrPostScriptConstruct)
+		{
+			for (FInstancedStruct& Struct : Structs)
+			{
+				if (Struct.IsValid())
+				{
+					Private::PostLoadStruct(FStructView(Struct));
+				}
+			}
+		}
+
+		return Structs;
+	}
+
+	TArray<UObject*> CreateObjects(const FName Serializer, const TConstArrayView<FFlake> Flakes, UObject* Outer, const UClass* ExpectedClass, const FWriteOptions& Options)
+	{
+		TArray<UObject*> Objects;
+		Objects.SetNumZeroed(Flakes.Num());
+
+		for (int32 Index = 0; Index < Flakes.Num(); ++Index)
+		{
+			Private::VerifyProvider(Flakes[Index], Serializer);
+
+			UStruct* Struct = nullptr;
+			if (Private::VerifyStruct(Flakes[Index], ExpectedClass, Struct))
+			{
+				if (const UClass* ObjClass = Cast<UClass>(Struct))
+				{
+					Objects[Index] = Private::NewOrPooledObject(Outer, ObjClass, Options);
+				}
+			}
+		}
+
+		// Decompression is the only part of object creation that can leave the game thread.
+		TArray<TArray<uint8>> Buffers;
+		TArray<TConstArrayView<uint8>> Raw;
+		TArray<bool> Valid;
+		if (!Private::DecompressBatch(Flakes, Buffers, Raw, Valid, Options))
+		{
+			UE_LOG(LogFlakes, Error, TEXT("CreateObjects: Failed to decompress one or more flakes"))
+		}
+
+		TArray<TOptional<TArray<UObject*>>> CreatedObjects;
+		CreatedObjects.SetNum(Objects.Num());
+
+		if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
+			[&](ISerializationProvider* Provider)
+			{
+				for (int32 Index = 0; Index < Objects.Num(); ++Index)
+				{
+					if (Objects[Index] && Valid[Index])
+					{
+						Private::FCreatedObjectsScope Scope(Options);
+						Provider->Virtual_WriteData(Objects[Index], Raw[Index]);
+						Scope.ReleaseStaleSubobjects(Options.ObjectPool);
+						CreatedObjects[Index] = Scope.ConsumeCreatedObjects();
+					}
+				}
+			}))
+		{
+			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+			return {};
+		}
+
+		if (Options.ExecPostLoadOrPostScriptConstruct)
+		{
+			for (int32 Index = 0; Index < Objects.Num(); ++Index)
+			{
+				if (Objects[Index])
+				{
+					Private::PostLoadUObject(Objects[Index], CreatedObjects[Index].GetPtrOrNull());
+				}
+			}
+		}
+
+		return Objects;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesData.h"
+#include "Serialization/CustomVersion.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(FlakesData)
+
+const FGuid FFlakesCustomVersion::GUID(0x6E1F3A2C, 0x4B8D47E1, 0x9A0C5F37, 0xD2B84C19);
+
+// Register the custom version with core
+FCustomVersionRegistration GRegisterFlakesCustomVersion(FFlakesCustomVersion::GUID, FFlakesCustomVersion::LatestVersion, TEXT("FlakesVer"));
\ No newline at end of file
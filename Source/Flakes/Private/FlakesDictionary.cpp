@@ -0,0 +1,121 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesDictionary.h"
+#include "Algo/Transform.h"
+#include "FlakesInterface.h"
+#include "FlakesLogging.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(FlakesDictionary)
+
+void FFlakesDictionary::Apply(const TArrayView<uint8> Payload) const
+{
+	const int32 Num = FMath::Min(Payload.Num(), Bytes.Num());
+	uint8* Data = Payload.GetData();
+	const uint8* Reference = Bytes.GetData();
+	for (int32 i = 0; i < Num; ++i)
+	{
+		Data[i] ^= Reference[i];
+	}
+}
+
+namespace Flakes::Dictionary
+{
+	FFlakesDictionary Train(const FName Name, const TConstArrayView<TConstArrayView<uint8>> Samples)
+	{
+		FFlakesDictionary Dictionary;
+		Dictionary.Name = Name;
+
+		if (Samples.IsEmpty())
+		{
+			return Dictionary;
+		}
+
+		// Only train over the bytes that at least half the samples have, past that the dictionary would mostly be noise.
+		TArray<int32> Lengths;
+		Algo::Transform(Samples, Lengths, [](const TConstArrayView<uint8> Sample) { return Sample.Num(); });
+		Lengths.Sort(TGreater<int32>());
+		const int32 Length = Lengths[(Lengths.Num() - 1) / 2];
+
+		// Each byte of the dictionary is the most common value at that offset in the samples.
+		Dictionary.Bytes.SetNumUninitialized(Length);
+		uint32 Histogram[256];
+		for (int32 Offset = 0; Offset < Length; ++Offset)
+		{
+			FMemory::Memzero(Histogram);
+			for (const TConstArrayView<uint8> Sample : Samples)
+			{
+				if (Sample.IsValidIndex(Offset))
+				{
+					Histogram[Sample[Offset]]++;
+				}
+			}
+
+			uint8 Mode = 0;
+			for (int32 Value = 1; Value < 256; ++Value)
+			{
+				if (Histogram[Value] > Histogram[Mode])
+				{
+					Mode = static_cast<uint8>(Value);
+				}
+			}
+			Dictionary.Bytes[Offset] = Mode;
+		}
+
+		Dictionary.Id = HashCombineFast(GetTypeHash(Name), FCrc::MemCrc32(Dictionary.Bytes.GetData(), Dictionary.Bytes.Num()));
+		if (Dictionary.Id == 0)
+		{
+			Dictionary.Id = 1;
+		}
+
+		return Dictionary;
+	}
+
+	FFlakesDictionary Train(const FName Name, const TConstArrayView<FFlake> Samples)
+	{
+		TArray<TArray<uint8>> Buffers;
+		TArray<TConstArrayView<uint8>> Payloads;
+		Buffers.SetNum(Samples.Num());
+		Payloads.Reserve(Samples.Num());
+
+		for (int32 i = 0; i < Samples.Num(); ++i)
+		{
+			if (Samples[i].Header.DictionaryId != 0)
+			{
+				UE_LOG(LogFlakes, Warning, TEXT("Dictionary::Train: Skipping sample that is already dictionary encoded"))
+				continue;
+			}
+
+			TConstArrayView<uint8> Raw;
+			if (Private::DecompressFlake(Samples[i], Buffers[i], Raw, {}))
+			{
+				Payloads.Add(Raw);
+			}
+		}
+
+		return Train(Name, Payloads);
+	}
+
+	bool SaveToFile(const FFlakesDictionary& Dictionary, const FString& Filename)
+	{
+		TArray<uint8> Bytes;
+		FMemoryWriter Writer(Bytes);
+		Writer << const_cast<FFlakesDictionary&>(Dictionary);
+		return FFileHelper::SaveArrayToFile(Bytes, *Filename);
+	}
+
+	bool LoadFromFile(const FString& Filename, FFlakesDictionary& OutDictionary)
+	{
+		TArray<uint8> Bytes;
+		if (!FFileHelper::LoadFileToArray(Bytes, *Filename))
+		{
+			return false;
+		}
+
+		FMemoryReader Reader(Bytes);
+		Reader << OutDictionary;
+		return !Reader.IsError() && OutDictionary.IsValid();
+	}
+}
\ No newline at end of file
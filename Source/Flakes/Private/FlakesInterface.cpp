@@ -2,11 +2,16 @@
 
 #include "FlakesInterface.h"
 #include "FlakesLogging.h"
+#include "FlakesMemory.h"
 #include "FlakesModule.h"
 
+#include "Async/ParallelFor.h"
 #include "Compression/OodleDataCompressionUtil.h"
+#include "Engine/StreamableManager.h"
 #include "GameFramework/Actor.h"
 
+#include <atomic>
+
 #if WITH_EDITOR
 #include "HAL/IConsoleManager.h"
 #endif
@@ -23,6 +28,43 @@ namespace Flakes
 {
 	namespace Private
 	{
+		struct FCompressorThroughput
+		{
+			FOodleDataCompression::ECompressor Compressor;
+			FOodleDataCompression::ECompressionLevel Level;
+
+			// Rough compression speed, in bytes per millisecond, on a modern desktop core.
+			float Throughput;
+		};
+
+		// Ordered from the strongest, slowest settings to the weakest, fastest ones.
+		static constexpr FCompressorThroughput CompressorThroughputTable[] =
+		{
+			{ FOodleDataCompression::ECompressor::Kraken, FOodleDataCompression::ECompressionLevel::Optimal1, 10000.f },
+			{ FOodleDataCompression::ECompressor::Kraken, FOodleDataCompression::ECompressionLevel::Normal, 70000.f },
+			{ FOodleDataCompression::ECompressor::Kraken, FOodleDataCompression::ECompressionLevel::Fast, 200000.f },
+			{ FOodleDataCompression::ECompressor::Kraken, FOodleDataCompression::ECompressionLevel::SuperFast, 350000.f },
+			{ FOodleDataCompression::ECompressor::Mermaid, FOodleDataCompression::ECompressionLevel::SuperFast, 500000.f },
+			{ FOodleDataCompression::ECompressor::Selkie, FOodleDataCompression::ECompressionLevel::VeryFast, 800000.f },
+			{ FOodleDataCompression::ECompressor::Selkie, FOodleDataCompression::ECompressionLevel::HyperFast4, 1500000.f },
+		};
+
+		// Picks the strongest compressor expected to keep up with the budget. Returns false if nothing is fast enough.
+		bool SelectCompressorForBudget(const float BytesPerMs,
+			FOodleDataCompression::ECompressor& OutCompressor, FOodleDataCompression::ECompressionLevel& OutLevel)
+		{
+			for (const FCompressorThroughput& Entry : CompressorThroughputTable)
+			{
+				if (Entry.Throughput >= BytesPerMs)
+				{
+					OutCompressor = Entry.Compressor;
+					OutLevel = Entry.Level;
+					return true;
+				}
+			}
+			return false;
+		}
+
 		bool VerifyStruct(const FFlake& Flake, const UStruct* Expected, UStruct*& OutStruct)
 		{
 			if (!ensureMsgf(IsValid(Expected), TEXT("VerifyStruct: Invalid Expected Type. Prefer passing UObject::StaticClass(), over nullptr")))
@@ -46,52 +88,367 @@ namespace Flakes
 			return true;
 		}
 
-		bool CompressFlake(FFlake& Flake, TArray<uint8>&& Raw, const FReadOptions& Options)
+		// Writes a single bare Oodle stream, since the header already tracks everything FOodleCompressedArray would store.
+		int64 CompressSingle(FFlake& Flake, const TConstArrayView<uint8> Raw,
+			const FOodleDataCompression::ECompressor Compressor, const FOodleDataCompression::ECompressionLevel Level)
 		{
-			if (Options.CompressionLevel == FOodleDataCompression::ECompressionLevel::None)
+			const int64 CompressedBufferSize = FOodleDataCompression::CompressedBufferSizeNeeded(Raw.Num());
+			Flake.Data.SetNumUninitialized(IntCastChecked<int32>(CompressedBufferSize));
+
+			return FOodleDataCompression::Compress(
+				Flake.Data.GetData(), CompressedBufferSize,
+				Raw.GetData(), Raw.Num(),
+				Compressor, Level);
+		}
+
+		// Splits the payload into independent chunks that are compressed in parallel, and records their compressed sizes
+		// in the header, so they can be decompressed in parallel as well.
+		int64 CompressChunked(FFlake& Flake, const TConstArrayView<uint8> Raw, const int32 ChunkSize,
+			const FOodleDataCompression::ECompressor Compressor, const FOodleDataCompression::ECompressionLevel Level)
+		{
+			const int32 NumChunks = FMath::DivideAndRoundUp(Raw.Num(), ChunkSize);
+			const int64 ChunkBound = FOodleDataCompression::CompressedBufferSizeNeeded(ChunkSize);
+
+			// Every chunk compresses into its own worst case sized slot, and the slots are packed together afterward.
+			Flake.Data.SetNumUninitialized(IntCastChecked<int32>(ChunkBound * NumChunks));
+			Flake.Header.ChunkSize = ChunkSize;
+			Flake.Header.Chunks.SetNumZeroed(NumChunks);
+
+			ParallelFor(NumChunks,
+				[&](const int32 Index)
+				{
+					const int64 RawOffset = static_cast<int64>(Index) * ChunkSize;
+					const int64 RawSize = FMath::Min<int64>(ChunkSize, Raw.Num() - RawOffset);
+
+					const int64 Size = FOodleDataCompression::Compress(
+						Flake.Data.GetData() + ChunkBound * Index, ChunkBound,
+						Raw.GetData() + RawOffset, RawSize,
+						Compressor, Level);
+
+					Flake.Header.Chunks[Index] = IntCastChecked<int32>(Size);
+				});
+
+			int64 PackedSize = 0;
+			for (int32 Index = 0; Index < NumChunks; ++Index)
 			{
-				Flake.Data = MoveTemp(Raw);
-				return true;
+				const int32 Size = Flake.Header.Chunks[Index];
+				if (Size <= 0)
+				{
+					Flake.Header.ChunkSize = 0;
+					Flake.Header.Chunks.Empty();
+					return 0;
+				}
+
+				FMemory::Memmove(Flake.Data.GetData() + PackedSize, Flake.Data.GetData() + ChunkBound * Index, Size);
+				PackedSize += Size;
+			}
+
+			return PackedSize;
+		}
+
+		bool DecompressChunked(const FFlake& Flake, TArray<uint8>& Buffer)
+		{
+			const int32 ChunkSize = Flake.Header.ChunkSize;
+			const int32 NumChunks = Flake.Header.Chunks.Num();
+			if (ChunkSize <= 0 || NumChunks != FMath::DivideAndRoundUp<int64>(Flake.Header.UncompressedSize, ChunkSize))
+			{
+				return false;
+			}
+
+			TArray<int64> Offsets;
+			Offsets.SetNumUninitialized(NumChunks);
+			int64 Offset = 0;
+			for (int32 Index = 0; Index < NumChunks; ++Index)
+			{
+				// Each chunk has to be checked on its own, as a negative size can balance out the total.
+				const int64 Size = Flake.Header.Chunks[Index];
+				if (Size <= 0 || Offset + Size > Flake.Data.Num())
+				{
+					return false;
+				}
+
+				Offsets[Index] = Offset;
+				Offset += Size;
+			}
+
+			if (Offset != Flake.Data.Num())
+			{
+				return false;
 			}
 
+			Buffer.SetNumUninitialized(static_cast<int32>(Flake.Header.UncompressedSize));
+
+			std::atomic<bool> Success = true;
+			ParallelFor(NumChunks,
+				[&](const int32 Index)
+				{
+					const int64 RawOffset = static_cast<int64>(Index) * ChunkSize;
+					const int64 RawSize = FMath::Min<int64>(ChunkSize, Buffer.Num() - RawOffset);
+
+					if (!FOodleDataCompression::Decompress(
+						Buffer.GetData() + RawOffset, RawSize,
+						Flake.Data.GetData() + Offsets[Index], Flake.Header.Chunks[Index]))
+					{
+						Success = false;
+					}
+				});
+
+			return Success;
+		}
+
+		enum class ECompressResult : uint8
+		{
+			Compressed,
+			StoreRaw,
+			Failed
+		};
+
+		// Compresses a payload into the flake's data, unless the options decide it should be stored raw.
+		ECompressResult TryCompress(FFlake& Flake, const TConstArrayView<uint8> Raw, const FReadOptions& Options)
+		{
+			FOodleDataCompression::ECompressor Compressor = Options.Compressor;
+			FOodleDataCompression::ECompressionLevel CompressionLevel = Options.CompressionLevel;
+
+			if (Options.AdaptiveCompression)
+			{
+				// Tiny payloads can't win back the size of Oodle's framing.
+				if (Raw.Num() < Options.MinCompressionSize)
+				{
+					return ECompressResult::StoreRaw;
+				}
+
+				if (Options.ThroughputBudget > 0.f &&
+					!SelectCompressorForBudget(Options.ThroughputBudget, Compressor, CompressionLevel))
+				{
+					return ECompressResult::StoreRaw;
+				}
+			}
+
+			if (CompressionLevel == FOodleDataCompression::ECompressionLevel::None)
+			{
+				return ECompressResult::StoreRaw;
+			}
+
+			const bool UseChunks = Options.ChunkedCompressionThreshold > 0 && Options.ChunkSize > 0 &&
+				Raw.Num() >= Options.ChunkedCompressionThreshold;
+
+			const int64 CompressedSize = UseChunks ?
+				CompressChunked(Flake, Raw, Options.ChunkSize, Compressor, CompressionLevel) :
+				CompressSingle(Flake, Raw, Compressor, CompressionLevel);
+
+			if (CompressedSize <= 0)
+			{
+				UE_LOG(LogFlakes, Error, TEXT("CompressFlake failed! Storing data uncompressed."))
+				return ECompressResult::Failed;
+			}
+
+			// Incompressible payloads are kept raw, so they don't pay for decompression on load.
+			if (Options.AdaptiveCompression &&
+				CompressedSize > static_cast<int64>(Raw.Num() * Options.MinCompressionRatio))
+			{
+				return ECompressResult::StoreRaw;
+			}
+
+			Flake.Data.SetNum(IntCastChecked<int32>(CompressedSize));
+			Flake.Header.Codec = UseChunks ? EFlakeCodec::OodleChunked : EFlakeCodec::Oodle;
+			Flake.Header.Compressor = static_cast<uint8>(Compressor);
+			Flake.Header.CompressionLevel = static_cast<int8>(CompressionLevel);
+
 #if WITH_EDITOR
-			const auto BeforeCompression = Raw.NumBytes();
+			if (CVarLogCompressionStatistics.GetValueOnAnyThread())
+			{
+				UE_LOG(LogFlakes, Log, TEXT("[Flake Compression Log]: Compressed '%llu' bytes to '%llu' bytes"), Raw.NumBytes(), Flake.Data.NumBytes());
+			}
 #endif
 
-			const bool Success = FOodleCompressedArray::CompressTArray(Flake.Data, Raw, Options.Compressor, Options.CompressionLevel);
-			if (!Success)
+			return ECompressResult::Compressed;
+		}
+
+		void MarkRaw(FFlake& Flake)
+		{
+			Flake.Header.Codec = EFlakeCodec::None;
+			Flake.Header.ChunkSize = 0;
+			Flake.Header.Chunks.Empty();
+		}
+
+#if WITH_EDITOR
+		FString MakeDebugString(const TConstArrayView<uint8> Raw, const bool Text)
+		{
+			if (Text)
 			{
-				UE_LOG(LogFlakes, Error, TEXT("CompressFlake failed!"))
+				return FString(FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(Raw.GetData()), Raw.Num()));
 			}
-#if WITH_EDITOR
-			else
+			return BytesToString(Raw.GetData(), Raw.Num());
+		}
+#endif
+
+		bool CompressFlake(FFlake& Flake, TArray<uint8>&& Raw, const FReadOptions& Options)
+		{
+			Flake.Header.Version = FFlakeHeader::CurrentVersion;
+			Flake.Header.UncompressedSize = Raw.Num();
+
+			if (Options.Dictionary)
 			{
-				const auto AfterCompression = Flake.Data.NumBytes();
-				if (CVarLogCompressionStatistics.GetValueOnGameThread())
+				if (Options.Dictionary->IsValid())
 				{
-					UE_LOG(LogFlakes, Log, TEXT("[Flake Compression Log]: Compressed '%llu' bytes to '%llu' bytes"), BeforeCompression, AfterCompression);
+					Options.Dictionary->Apply(Raw);
+					Flake.Header.DictionaryId = Options.Dictionary->Id;
+				}
+				else
+				{
+					UE_LOG(LogFlakes, Warning, TEXT("CompressFlake: Ignoring invalid dictionary '%s'"), *Options.Dictionary->Name.ToString())
 				}
 			}
-#endif
 
-			return Success;
+			const ECompressResult Result = TryCompress(Flake, Raw, Options);
+			if (Result != ECompressResult::Compressed)
+			{
+				MarkRaw(Flake);
+				Flake.Data = MoveTemp(Raw);
+			}
+
+			return Result != ECompressResult::Failed;
 		}
 
-		bool DecompressFlake(const FFlake& Flake, TArray<uint8>& Raw, const FWriteOptions& Options)
+		bool CompressFlake(FFlake& Flake, const TConstArrayView<uint8> Raw, const FReadOptions& Options)
 		{
+			// Dictionary encoding modifies the payload, so it needs its own copy.
+			if (Options.Dictionary)
+			{
+				return CompressFlake(Flake, TArray<uint8>(Raw), Options);
+			}
+
+			Flake.Header.Version = FFlakeHeader::CurrentVersion;
+			Flake.Header.UncompressedSize = Raw.Num();
+
+			const ECompressResult Result = TryCompress(Flake, Raw, Options);
+			if (Result != ECompressResult::Compressed)
+			{
+				MarkRaw(Flake);
+				Flake.Data.Reset(Raw.Num());
+				Flake.Data.Append(Raw.GetData(), Raw.Num());
+			}
+
+			return Result != ECompressResult::Failed;
+		}
+
+		// Reverses the dictionary encoding of a payload, if one was applied.
+		bool DecodeDictionary(const FFlake& Flake, TArray<uint8>& Buffer, TConstArrayView<uint8>& OutRaw, const FWriteOptions& Options)
+		{
+			if (Flake.Header.DictionaryId == 0)
+			{
+				return true;
+			}
+
+			// Holds a registered dictionary until the payload is decoded, in case it's removed on another thread.
+			FFlakesDictionaryPtr Registered;
+			const FFlakesDictionary* Dictionary = Options.Dictionary;
+			if (!Dictionary || Dictionary->Id != Flake.Header.DictionaryId)
+			{
+				Registered = FFlakesModule::Get().FindDictionary(Flake.Header.DictionaryId);
+				Dictionary = Registered.Get();
+			}
+
+			if (!Dictionary)
+			{
+				UE_LOG(LogFlakes, Error, TEXT("DecompressFlake: Missing dictionary '%u'"), Flake.Header.DictionaryId)
+				return false;
+			}
+
+			// Uncompressed payloads still point into the flake, and must be copied before they can be decoded.
+			if (OutRaw.GetData() != Buffer.GetData())
+			{
+				Buffer.Reset(OutRaw.Num());
+				Buffer.Append(OutRaw.GetData(), OutRaw.Num());
+			}
+
+			Dictionary->Apply(Buffer);
+			OutRaw = Buffer;
+			return true;
+		}
+
+		bool DecompressFlake(const FFlake& Flake, TArray<uint8>& Buffer, TConstArrayView<uint8>& OutRaw, const FWriteOptions& Options)
+		{
+			if (Flake.Header.Version > FFlakeHeader::CurrentVersion)
+			{
+				UE_LOG(LogFlakes, Error, TEXT("DecompressFlake: Flake version '%i' is newer than supported version '%i'"),
+					Flake.Header.Version, FFlakeHeader::CurrentVersion)
+				return false;
+			}
+
+			// The header may come from disk, so its size can't be trusted to fit an array.
+			if (Flake.Header.UncompressedSize < 0 || Flake.Header.UncompressedSize > MAX_int32)
+			{
+				UE_LOG(LogFlakes, Error, TEXT("DecompressFlake: Invalid uncompressed size '%lld'"), Flake.Header.UncompressedSize)
+				return false;
+			}
+
+			switch (Flake.Header.Codec)
+			{
+			case EFlakeCodec::None:
+				OutRaw = Flake.Data;
+				return DecodeDictionary(Flake, Buffer, OutRaw, Options);
+
+			case EFlakeCodec::Oodle:
+				{
+					// The header knows the exact size, so the output is allocated once, and never resized.
+					Buffer.SetNumUninitialized(static_cast<int32>(Flake.Header.UncompressedSize));
+					if (!FOodleDataCompression::Decompress(Buffer.GetData(), Buffer.Num(), Flake.Data.GetData(), Flake.Data.Num()))
+					{
+						UE_LOG(LogFlakes, Error, TEXT("DecompressFlake failed!"))
+						return false;
+					}
+					OutRaw = Buffer;
+					return DecodeDictionary(Flake, Buffer, OutRaw, Options);
+				}
+
+			case EFlakeCodec::OodleChunked:
+				{
+					if (!DecompressChunked(Flake, Buffer))
+					{
+						UE_LOG(LogFlakes, Error, TEXT("DecompressFlake failed!"))
+						return false;
+					}
+					OutRaw = Buffer;
+					return DecodeDictionary(Flake, Buffer, OutRaw, Options);
+				}
+
+			case EFlakeCodec::Unknown:
+			default:
+				break;
+			}
+
+			// Legacy flakes have to trust the options to tell them if they are compressed.
 			if (Options.SkipDecompressionStep)
 			{
-				// @todo remove this copy please
-				Raw = Flake.Data;
+				OutRaw = Flake.Data;
 				return true;
 			}
 
-			const bool Success = FOodleCompressedArray::DecompressToTArray(Raw, Flake.Data);
-			if (!Success)
+			if (!FOodleCompressedArray::DecompressToTArray(Buffer, Flake.Data))
 			{
 				UE_LOG(LogFlakes, Error, TEXT("DecompressFlake failed!"))
+				return false;
 			}
-			return Success;
+
+			OutRaw = Buffer;
+			return true;
+		}
+
+		void VerifyProvider(const FFlake& Flake, const FName Provider)
+		{
+			if (!Flake.Header.Provider.IsNone() && Flake.Header.Provider != Provider)
+			{
+				UE_LOG(LogFlakes, Warning, TEXT("Flake created by provider '%s' is being read by provider '%s'"),
+					*Flake.Header.Provider.ToString(), *Provider.ToString())
+			}
+		}
+
+		bool CanSerializeOffGameThread(const UScriptStruct* Struct)
+		{
+			// RefLink chains every property that can hold a reference to a UObject, directly or through inner structs.
+			// Structs that report their own references, like instanced structs, may hold any object.
+			return IsValid(Struct) && Struct->RefLink == nullptr && !(Struct->StructFlags & STRUCT_AddStructReferencedObjects);
 		}
 
 		void PostLoadStruct(const FStructView& Struct)
@@ -104,18 +461,138 @@ namespace Flakes
 			}
 		}
 
-		void PostLoadUObject(UObject* Object)
+		static thread_local FCreatedObjectsScope* CurrentCreatedObjectsScope = nullptr;
+
+		FCreatedObjectsScope::FCreatedObjectsScope(const bool ReuseSubobjects, const bool ReconcileSubobjects)
+		  : Previous(CurrentCreatedObjectsScope),
+			ReuseSubobjects(ReuseSubobjects),
+			ReconcileSubobjects(ReconcileSubobjects)
+		{
+			CurrentCreatedObjectsScope = this;
+		}
+
+		FCreatedObjectsScope::~FCreatedObjectsScope()
+		{
+			check(CurrentCreatedObjectsScope == this);
+			CurrentCreatedObjectsScope = Previous;
+		}
+
+		FCreatedObjectsScope* FCreatedObjectsScope::Get()
+		{
+			return CurrentCreatedObjectsScope;
+		}
+
+		TOptional<TArray<UObject*>> FCreatedObjectsScope::ConsumeCreatedObjects()
+		{
+			if (!Recorded)
+			{
+				return {};
+			}
+
+			Recorded = false;
+			return MoveTemp(Objects);
+		}
+
+		void FCreatedObjectsScope::ReleaseStaleSubobjects(IObjectPool* Pool)
+		{
+			if (Replaced.IsEmpty())
+			{
+				return;
+			}
+
+			const TSet<UObject*> ReadObjects(Objects);
+			for (UObject* Object : Replaced)
+			{
+				// Objects that moved to another slot are still in use, and default subobjects are owned by their class.
+				if (ReadObjects.Contains(Object) || !IsValid(Object) || Object->HasAnyFlags(RF_DefaultSubObject))
+				{
+					continue;
+				}
+
+				if (Pool && Pool->Release(Object))
+				{
+					continue;
+				}
+
+				Object->Rename(nullptr, GetTransientPackage(), REN_DontCreateRedirectors | REN_NonTransactional);
+				Object->MarkAsGarbage();
+			}
+
+			Replaced.Empty();
+		}
+
+		void ResetToClassDefaults(UObject* Object)
+		{
+			const UObject* Defaults = Object->GetClass()->GetDefaultObject();
+
+			for (TFieldIterator<FProperty> It(Object->GetClass()); It; ++It)
+			{
+				if (It->HasAnyPropertyFlags(CPF_InstancedReference | CPF_ContainsInstancedReference))
+				{
+					continue;
+				}
+
+				// Plain pointers to subobjects the object owns are kept too, element by element, so they can be reused.
+				if (const FObjectPropertyBase* ObjectProperty = CastField<FObjectPropertyBase>(*It))
+				{
+					for (int32 Index = 0; Index < ObjectProperty->GetArrayDim(); ++Index)
+					{
+						const UObject* Value = ObjectProperty->GetObjectPropertyValue_InContainer(Object, Index);
+						if (!Value || Value->GetOuter() != Object)
+						{
+							ObjectProperty->CopySingleValue(ObjectProperty->ContainerPtrToValuePtr<void>(Object, Index),
+								ObjectProperty->ContainerPtrToValuePtr<void>(Defaults, Index));
+						}
+					}
+					continue;
+				}
+
+				It->CopyCompleteValue_InContainer(Object, Defaults);
+			}
+		}
+
+		UObject* NewOrPooledObject(UObject* Outer, const UClass* Class, const FWriteOptions& Options)
+		{
+			if (Options.ObjectPool)
+			{
+				if (UObject* Pooled = Options.ObjectPool->Acquire(Class, Outer))
+				{
+					if (ensureMsgf(Pooled->GetClass() == Class, TEXT("Object pool returned '%s', when asked for '%s'"),
+						*Pooled->GetClass()->GetName(), *Class->GetName()))
+					{
+						if (Pooled->GetOuter() != Outer)
+						{
+							Pooled->Rename(nullptr, Outer, REN_DontCreateRedirectors | REN_NonTransactional);
+						}
+
+						ResetToClassDefaults(Pooled);
+						return Pooled;
+					}
+				}
+			}
+
+			return NewObject<UObject>(Outer, Class);
+		}
+
+		void PostLoadUObject(UObject* Object, const TArray<UObject*>* CreatedObjects)
 		{
 			Object->PostLoad();
-			TArray<UObject*> SubObjects;
-			ForEachObjectWithOuter(Object,
-				[&SubObjects](UObject* Subobject)
+
+			if (CreatedObjects)
+			{
+				for (UObject* SubObject : *CreatedObjects)
 				{
-					SubObjects.Add(Subobject);
-				});
+					SubObject->PostLoad();
+				}
+				return;
+			}
 
+			// Providers that don't report what they create, such as Json, fall back to finding every nested subobject.
 			// Cannot call PostLoad from inside ForEachObjectWithOuter, since if PostLoad calls NewObject, it will trip
 			// a check that prevents creation of new objects while iterating over the UObject table.
+			TArray<UObject*> SubObjects;
+			GetObjectsWithOuter(Object, SubObjects, true);
+
 			for (UObject* SubObject : SubObjects)
 			{
 				SubObject->PostLoad();
@@ -124,27 +601,49 @@ namespace Flakes
 	}
 
 	FFlake MakeFlake(const FName Serializer, const FConstStructView& Struct, const UObject* Outer, const FReadOptions Options)
+	{
+		return MakeFlake(FFlakesProviderHandle(Serializer), Struct, Outer, Options);
+	}
+
+	FFlake MakeFlake(const FName Serializer, const UObject* Object, const FReadOptions Options)
+	{
+		return MakeFlake(FFlakesProviderHandle(Serializer), Object, Options);
+	}
+
+	void WriteStruct(const FName Serializer, const FStructView& Struct, const FFlake& Flake, UObject* Outer, const FWriteOptions Options)
+	{
+		WriteStruct(FFlakesProviderHandle(Serializer), Struct, Flake, Outer, Options);
+	}
+
+	void WriteObject(const FName Serializer, UObject* Object, const FFlake& Flake, const FWriteOptions Options)
+	{
+		WriteObject(FFlakesProviderHandle(Serializer), Object, Flake, Options);
+	}
+
+	FFlake MakeFlake(const FFlakesProviderHandle& Serializer, const FConstStructView& Struct, const UObject* Outer, const FReadOptions& Options)
 	{
 		TArray<uint8> Raw;
+		bool Text = false;
 
 		if (Struct.IsValid())
 		{
-			if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
-				[&](ISerializationProvider* Provider)
-				{
-					Provider->Virtual_ReadData(Struct, Raw, Outer);
-				}))
+			const FFlakesProviderPtr Provider = Serializer.Pin();
+			if (!Provider.IsValid())
 			{
-				UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
+				UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.GetName().ToString())
 				return FFlake();
 			}
+
+			Provider->Virtual_ReadData(Struct, Raw, Outer);
+			Text = Provider->IsText();
 		}
 
 		FFlake Flake;
 		Flake.Struct = Struct.GetScriptStruct();
+		Flake.Header.Provider = Serializer.GetName();
 
 #if WITH_EDITOR
-		Flake.DebugString = BytesToString(Raw.GetData(), Raw.Num());
+		Flake.DebugString = Private::MakeDebugString(Raw, Text);
 #endif
 
 		(void)Private::CompressFlake(Flake, MoveTemp(Raw), Options);
@@ -152,27 +651,26 @@ namespace Flakes
 		return Flake;
 	}
 
-	FFlake MakeFlake(const FName Serializer, const UObject* Object, const FReadOptions Options)
+	FFlake MakeFlake(const FFlakesProviderHandle& Serializer, const UObject* Object, const FReadOptions& Options)
 	{
 		check(Object && !Object->IsA<AActor>());
 
+		const FFlakesProviderPtr Provider = Serializer.Pin();
+		if (!Provider.IsValid())
+		{
+			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.GetName().ToString())
+			return FFlake();
+		}
+
 		FFlake Flake;
 		Flake.Struct = Object->GetClass();
+		Flake.Header.Provider = Serializer.GetName();
 
 		TArray<uint8> Raw;
-
-		if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
-			[&](ISerializationProvider* Provider)
-			{
-				Provider->Virtual_ReadData(Object, Raw);
-			}))
-		{
-			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
-			return FFlake();
-		}
+		Provider->Virtual_ReadData(Object, Raw);
 
 #if WITH_EDITOR
-		Flake.DebugString = BytesToString(Raw.GetData(), Raw.Num());
+		Flake.DebugString = Private::MakeDebugString(Raw, Provider->IsText());
 #endif
 
 		(void)Private::CompressFlake(Flake, MoveTemp(Raw), Options);
@@ -180,52 +678,101 @@ namespace Flakes
 		return Flake;
 	}
 
-	void WriteStruct(const FName Serializer, const FStructView& Struct, const FFlake& Flake, UObject* Outer, const FWriteOptions Options)
+	void WriteStruct(const FFlakesProviderHandle& Serializer, const FStructView& Struct, const FFlake& Flake, UObject* Outer, const FWriteOptions& Options)
 	{
-		TArray<uint8> Raw;
-		if (!Private::DecompressFlake(Flake, Raw, Options))
+		Private::VerifyProvider(Flake, Serializer.GetName());
+
+		const FFlakesProviderPtr Provider = Serializer.Pin();
+		if (!Provider.IsValid())
 		{
+			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.GetName().ToString())
 			return;
 		}
 
-		if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
-			[&](ISerializationProvider* Provider)
-			{
-				Provider->Virtual_WriteData(Struct, Raw, Outer);
-			}))
+		TArray<uint8> Buffer;
+		TConstArrayView<uint8> Raw;
+		if (!Private::DecompressFlake(Flake, Buffer, Raw, Options))
 		{
-			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
 			return;
 		}
 
+		Provider->Virtual_WriteData(Struct, Raw, Outer);
+
 		if (Options.ExecPostLoadOrPostScriptConstruct)
 		{
 			Private::PostLoadStruct(Struct);
 		}
 	}
 
-	void WriteObject(const FName Serializer, UObject* Object, const FFlake& Flake, const FWriteOptions Options)
+	void WriteObject(const FFlakesProviderHandle& Serializer, UObject* Object, const FFlake& Flake, const FWriteOptions& Options)
 	{
-		TArray<uint8> Raw;
-		if (!Private::DecompressFlake(Flake, Raw, Options))
+		Private::VerifyProvider(Flake, Serializer.GetName());
+
+		const FFlakesProviderPtr Provider = Serializer.Pin();
+		if (!Provider.IsValid())
 		{
+			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.GetName().ToString())
 			return;
 		}
 
-		if (!FFlakesModule::Get().UseSerializationProvider(Serializer,
-			[&](ISerializationProvider* Provider)
-			{
-				Provider->Virtual_WriteData(Object, Raw);
-			}))
+		TArray<uint8> Buffer;
+		TConstArrayView<uint8> Raw;
+		if (!Private::DecompressFlake(Flake, Buffer, Raw, Options))
 		{
-			UE_LOG(LogFlakes, Error, TEXT("Invalid Serializer at runtime: %s"), *Serializer.ToString())
 			return;
 		}
 
+		Private::FCreatedObjectsScope CreatedObjects(Options);
+		Provider->Virtual_WriteData(Object, Raw);
+		CreatedObjects.ReleaseStaleSubobjects(Options.ObjectPool);
+
 		if (Options.ExecPostLoadOrPostScriptConstruct)
 		{
-			Private::PostLoadUObject(Object);
+			Private::PostLoadUObject(Object, CreatedObjects.GetCreatedObjects());
+		}
+	}
+
+	void GatherDependencies(const FFlake& Flake, TArray<FSoftObjectPath>& OutPaths, const FWriteOptions& Options)
+	{
+		if (Flake.Struct.IsValid())
+		{
+			OutPaths.Add(Flake.Struct);
+		}
+
+		TArray<uint8> Buffer;
+		TConstArrayView<uint8> Raw;
+		if (!Private::DecompressFlake(Flake, Buffer, Raw, Options))
+		{
+			return;
 		}
+
+		FRecursiveMemoryReader::GatherPaths(Raw, OutPaths);
+	}
+
+	TSharedPtr<FStreamableHandle> PreloadDependencies(const FFlake& Flake, TFunction<void()>&& OnLoaded, const FWriteOptions& Options)
+	{
+		check(IsInGameThread());
+
+		TArray<FSoftObjectPath> Paths;
+		GatherDependencies(Flake, Paths, Options);
+
+		// References to objects that are already loaded, including those in the transient package or a world, need no
+		// loading, and couldn't be loaded from disk anyway.
+		Paths.RemoveAll([](const FSoftObjectPath& Path)
+			{
+				return Path.IsNull() || Path.ResolveObject() != nullptr;
+			});
+
+		if (Paths.IsEmpty())
+		{
+			if (OnLoaded)
+			{
+				OnLoaded();
+			}
+			return nullptr;
+		}
+
+		return FFlakesModule::Get().GetStreamableManager().RequestAsyncLoad(MoveTemp(Paths), MoveTemp(OnLoaded));
 	}
 
 	FInstancedStruct CreateStruct(const FName Serializer, const FFlake& Flake, const UScriptStruct* ExpectedStruct, const FWriteOptions Options, UObject* Outer)
@@ -261,7 +808,7 @@ namespace Flakes
 			return nullptr;
 		}
 
-		UObject* LoadedObject = NewObject<UObject>(Outer, ObjClass);
+		UObject* LoadedObject = Private::NewOrPooledObject(Outer, ObjClass, Options);
 		WriteObject(Serializer, LoadedObject, Flake, Options);
 
 		return LoadedObject;
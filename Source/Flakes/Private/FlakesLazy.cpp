@@ -0,0 +1,160 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesLazy.h"
+#include "FlakesLogging.h"
+#include "FlakesModule.h"
+#include "Misc/ScopeLock.h"
+
+#include <atomic>
+
+namespace Flakes
+{
+	struct FLazyFlake::FState
+	{
+		FCriticalSection Lock;
+		std::atomic<bool> Resolved = false;
+		FFlake Flake;
+
+		// The snapshot, which is released once the flake is made.
+		FName Serializer;
+		FReadOptions Options;
+		FInstancedStruct Struct;
+		TWeakObjectPtr<const UObject> Outer;
+		TWeakObjectPtr<const UObject> Object;
+		TFunction<uint32()> ChangeCounter;
+		uint32 ChangeCount = 0;
+
+		// Can the struct be made on any thread, or only the game thread.
+		bool AnyThread = false;
+
+		void Resolve()
+		{
+			if (Struct.IsValid())
+			{
+				checkf(AnyThread || IsInGameThread(), TEXT("FLazyFlake: Provider '%s' can only be used on the game thread"),
+					*Serializer.ToString());
+				Flake = MakeFlake(Serializer, FConstStructView(Struct), Outer.Get(), Options);
+			}
+			else if (const UObject* Obj = Object.Get())
+			{
+				check(IsInGameThread());
+
+				// The state the flake was meant to capture is gone, so no flake is better than one of the wrong state.
+				if (ChangeCounter && ChangeCounter() != ChangeCount)
+				{
+					UE_LOG(LogFlakes, Error, TEXT("FLazyFlake: '%s' was modified before its flake was made"), *Obj->GetName())
+				}
+				else
+				{
+					Flake = MakeFlake(Serializer, Obj, Options);
+				}
+			}
+			else if (!Object.IsExplicitlyNull())
+			{
+				UE_LOG(LogFlakes, Error, TEXT("FLazyFlake: Object was destroyed before its flake was made"))
+			}
+
+			Struct.Reset();
+			Outer.Reset();
+			Object.Reset();
+			ChangeCounter.Reset();
+		}
+	};
+
+	FLazyFlake::FLazyFlake(const FFlake& Flake)
+	  : State(MakeShared<FState, ESPMode::ThreadSafe>())
+	{
+		State->Flake = Flake;
+		State->Resolved = true;
+	}
+
+	FLazyFlake::FLazyFlake(const FName Serializer, const FConstStructView& Struct, const UObject* Outer, const FReadOptions& Options)
+	  : State(MakeShared<FState, ESPMode::ThreadSafe>())
+	{
+		// The copy isn't seen by garbage collection, so it can't be trusted to keep any objects it references alive.
+		if (Struct.IsValid() && !Private::CanSerializeOffGameThread(Struct.GetScriptStruct()))
+		{
+			State->Flake = MakeFlake(Serializer, Struct, Outer, Options);
+			State->Resolved = true;
+			return;
+		}
+
+		State->Serializer = Serializer;
+		State->Options = Options;
+		State->Struct = FInstancedStruct(Struct);
+		State->Outer = Outer;
+
+		FFlakesModule::Get().UseSerializationProvider(Serializer,
+			[this](const ISerializationProvider* Provider)
+			{
+				State->AnyThread = Provider->IsThreadSafe();
+			});
+	}
+
+	FLazyFlake::FLazyFlake(const FName Serializer, const UObject* Object, TFunction<uint32()>&& ChangeCounter, const FReadOptions& Options)
+	  : State(MakeShared<FState, ESPMode::ThreadSafe>())
+	{
+		check(Object && !Object->IsA<AActor>());
+
+		State->Serializer = Serializer;
+		State->Options = Options;
+		State->Object = Object;
+		State->ChangeCounter = MoveTemp(ChangeCounter);
+		if (State->ChangeCounter)
+		{
+			State->ChangeCount = State->ChangeCounter();
+		}
+	}
+
+	bool FLazyFlake::IsResolved() const
+	{
+		return State.IsValid() && State->Resolved.load(std::memory_order_acquire);
+	}
+
+	bool FLazyFlake::IsStale() const
+	{
+		if (!State.IsValid() || IsResolved())
+		{
+			return false;
+		}
+
+		FScopeLock Lock(&State->Lock);
+		return State->ChangeCounter && State->ChangeCounter() != State->ChangeCount;
+	}
+
+	const FFlake& FLazyFlake::Get() const
+	{
+		if (!State.IsValid())
+		{
+			static const FFlake Empty;
+			return Empty;
+		}
+
+		if (!State->Resolved.load(std::memory_order_acquire))
+		{
+			FScopeLock Lock(&State->Lock);
+			if (!State->Resolved.load(std::memory_order_relaxed))
+			{
+				State->Resolve();
+				State->Resolved.store(true, std::memory_order_release);
+			}
+		}
+
+		return State->Flake;
+	}
+
+	FArchive& operator<<(FArchive& Ar, FLazyFlake& Flake)
+	{
+		if (Ar.IsLoading())
+		{
+			FFlake Loaded;
+			Ar << Loaded;
+			Flake = FLazyFlake(Loaded);
+		}
+		else
+		{
+			Ar << const_cast<FFlake&>(Flake.Get());
+		}
+		return Ar;
+	}
+}
\ No newline at end of file
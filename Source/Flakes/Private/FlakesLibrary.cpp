@@ -2,11 +2,75 @@
 
 #include "FlakesLibrary.h"
 #include "FlakesModule.h"
+#include "Engine/Engine.h"
 #include "Engine/World.h"
 #include "GameFramework/Actor.h"
+#include "LatentActions.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(FlakesLibrary)
 
+namespace Flakes::Private
+{
+	template <typename T>
+	T ConsumeResult(T&& Value)
+	{
+		return MoveTemp(Value);
+	}
+
+	// The task holds the object until here, from where the Blueprint's output references it.
+	inline UObject* ConsumeResult(TStrongObjectPtr<UObject>&& Object)
+	{
+		return Object.Get();
+	}
+
+	// Polls an async flake task, and copies its result into the Blueprint's output once it completes.
+	template <typename T, typename TTaskResult = T>
+	class TFlakesLatentAction final : public FPendingLatentAction
+	{
+	public:
+		TFlakesLatentAction(const FLatentActionInfo& LatentInfo, const UE::Tasks::TTask<TTaskResult>& Task, T& Result)
+		  : ExecutionFunction(LatentInfo.ExecutionFunction),
+			OutputLink(LatentInfo.Linkage),
+			CallbackTarget(LatentInfo.CallbackTarget),
+			Task(Task),
+			Result(Result) {}
+
+		virtual void UpdateOperation(FLatentResponse& Response) override
+		{
+			if (Task.IsCompleted())
+			{
+				Result = ConsumeResult(MoveTemp(Task.GetResult()));
+				Response.FinishAndTriggerIf(true, ExecutionFunction, OutputLink, CallbackTarget);
+			}
+		}
+
+	private:
+		FName ExecutionFunction;
+		int32 OutputLink;
+		FWeakObjectPtr CallbackTarget;
+		UE::Tasks::TTask<TTaskResult> Task;
+		T& Result;
+	};
+
+	template <typename T, typename TTaskResult = T>
+	void AddLatentAction(const UObject* WorldContextObj, const FLatentActionInfo& LatentInfo, TFunctionRef<UE::Tasks::TTask<TTaskResult>()> MakeTask, T& Result)
+	{
+		UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObj, EGetWorldErrorMode::LogAndReturnNull);
+		if (!World)
+		{
+			return;
+		}
+
+		FLatentActionManager& LatentManager = World->GetLatentActionManager();
+		if (LatentManager.FindExistingAction<TFlakesLatentAction<T, TTaskResult>>(LatentInfo.CallbackTarget, LatentInfo.UUID))
+		{
+			return;
+		}
+
+		LatentManager.AddNewAction(LatentInfo.CallbackTarget, LatentInfo.UUID, new TFlakesLatentAction<T, TTaskResult>(LatentInfo, MakeTask(), Result));
+	}
+}
+
 TArray<FString> UFlakesLibrary::GetAllProviders()
 {
 	TArray<FString> Out;
@@ -78,6 +142,39 @@ AActor* UFlakesLibrary::ConstructActorFromFlake(const FFlake_Actor& Flake, UObje
 	return nullptr;
 }
 
+void UFlakesLibrary::MakeFlakeAsync_Struct(UObject* WorldContextObj, const FLatentActionInfo LatentInfo,
+	const FInstancedStruct& Struct, FFlake& Flake, const FName Serializer)
+{
+	Flakes::Private::AddLatentAction<FFlake>(WorldContextObj, LatentInfo,
+		[&]{ return Flakes::MakeFlakeAsync(Serializer, Struct, nullptr); }, Flake);
+}
+
+void UFlakesLibrary::MakeFlakeAsync(UObject* WorldContextObj, const FLatentActionInfo LatentInfo,
+	const UObject* Object, FFlake& Flake, const FName Serializer)
+{
+	if (!IsValid(Object))
+	{
+		return;
+	}
+
+	Flakes::Private::AddLatentAction<FFlake>(WorldContextObj, LatentInfo,
+		[&]{ return Flakes::MakeFlakeAsync(Serializer, Object); }, Flake);
+}
+
+void UFlakesLibrary::ConstructStructFromFlakeAsync(UObject* WorldContextObj, const FLatentActionInfo LatentInfo,
+	const FFlake& Flake, const UScriptStruct* ExpectedStruct, FInstancedStruct& Struct, const FName Serializer)
+{
+	Flakes::Private::AddLatentAction<FInstancedStruct>(WorldContextObj, LatentInfo,
+		[&]{ return Flakes::CreateStructAsync(Serializer, Flake, ExpectedStruct); }, Struct);
+}
+
+void UFlakesLibrary::ConstructObjectFromFlakeAsync(UObject* WorldContextObj, const FLatentActionInfo LatentInfo,
+	const FFlake& Flake, UObject* Outer, const UClass* ExpectedClass, UObject*& Object, const FName Serializer)
+{
+	Flakes::Private::AddLatentAction<UObject*, TStrongObjectPtr<UObject>>(WorldContextObj, LatentInfo,
+		[&]{ return Flakes::CreateObjectAsync(Serializer, Flake, Outer, ExpectedClass); }, Object);
+}
+
 int64 UFlakesLibrary::GetNumBytes(const FFlake& Flake)
 {
 	return static_cast<int64>(Flake.Data.NumBytes());
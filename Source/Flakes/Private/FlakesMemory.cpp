@@ -1,10 +1,26 @@
 ﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
 
 #include "FlakesMemory.h"
+#include "FlakesInterface.h"
 #include "FlakesLogging.h"
 #include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/EnumProperty.h"
 #include "UObject/Object.h"
 #include "UObject/SoftObjectPath.h"
+#include "UObject/UnrealType.h"
+
+static TAutoConsoleVariable<bool> CVarInternNames{
+	TEXT("flakes.InternNames"),
+	true,
+	TEXT("Write names and soft paths once per binary flake, and refer to them by index")
+};
+
+static TAutoConsoleVariable<int32> CVarBulkArrayAlignment{
+	TEXT("flakes.BulkArrayAlignment"),
+	16,
+	TEXT("Alignment of bulk array blocks from the start of a binary flake, so they can be read with SIMD loads. Must be a power of two, up to 128. Anything else packs them")
+};
 
 namespace Flakes
 {
@@ -17,31 +33,264 @@ namespace Flakes
 
 		// Any other object reference is treated as a SoftObjectRef
 		Reference,
+
+		// An object that was already exported earlier in the same archive, written as its index in export order
+		BackReference,
 	};
 
-	FArchive& FRecursiveMemoryWriter::operator<<(UObject*& Obj)
+	namespace Private
 	{
-		// Don't serialize nulls
-		if (!IsValid(Obj))
+		// Only numbers, enums, and bools are written in bulk. Their layout can't change without their size or type
+		// changing too, unlike structs, which would lose the schema evolution of tagged serialization.
+		bool IsBulkElement(const FProperty* Inner)
 		{
-			return *this;
+			return Inner->IsA<FNumericProperty>() || Inner->IsA<FEnumProperty>() || Inner->IsA<FBoolProperty>();
 		}
 
-		ERecursiveMemoryObj Op = ERecursiveMemoryObj::None;
+		// Top-level arrays of numbers in Data that have anything in them, which can be written in bulk.
+		void GatherBulkArrays(const UStruct* Struct, const void* Data, TArray<const FArrayProperty*, TInlineAllocator<8>>& OutArrays)
+		{
+			// Structs with their own Serialize may not serialize their properties at all.
+			if (const UScriptStruct* ScriptStruct = Cast<UScriptStruct>(Struct);
+				ScriptStruct && (ScriptStruct->StructFlags & STRUCT_SerializeNative))
+			{
+				return;
+			}
+
+			for (TFieldIterator<FArrayProperty> It(Struct); It; ++It)
+			{
+				if (It->HasAnyPropertyFlags(CPF_Transient | CPF_Deprecated | CPF_SkipSerialization) ||
+					It->GetArrayDim() != 1 || !IsBulkElement(It->Inner))
+				{
+					continue;
+				}
+
+				if (FScriptArrayHelper(*It, It->ContainerPtrToValuePtr<void>(Data)).Num() > 0)
+				{
+					OutArrays.Add(*It);
+				}
+			}
+		}
+
+		// Subobjects of Obj held in the arrays, sets, and maps directly in it.
+		void GatherContainedSubobjects(UObject* Obj, TArray<UObject*>& OutObjects)
+		{
+			auto Gather = [Obj, &OutObjects](const FProperty* Property, const void* Value)
+				{
+					if (const FObjectPropertyBase* ObjectProperty = CastField<FObjectPropertyBase>(Property))
+					{
+						UObject* Object = ObjectProperty->GetObjectPropertyValue(Value);
+						if (IsValid(Object) && Object->GetOuter() == Obj)
+						{
+							OutObjects.Add(Object);
+						}
+					}
+				};
+
+			for (TFieldIterator<FProperty> It(Obj->GetClass()); It; ++It)
+			{
+				if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(*It))
+				{
+					FScriptArrayHelper Helper(ArrayProperty, ArrayProperty->ContainerPtrToValuePtr<void>(Obj));
+					for (int32 Index = 0; Index < Helper.Num(); ++Index)
+					{
+						Gather(ArrayProperty->Inner, Helper.GetRawPtr(Index));
+					}
+				}
+				else if (const FSetProperty* SetProperty = CastField<FSetProperty>(*It))
+				{
+					FScriptSetHelper Helper(SetProperty, SetProperty->ContainerPtrToValuePtr<void>(Obj));
+					for (FScriptSetHelper::FIterator SetIt(Helper); SetIt; ++SetIt)
+					{
+						Gather(SetProperty->ElementProp, Helper.GetElementPtr(SetIt));
+					}
+				}
+				else if (const FMapProperty* MapProperty = CastField<FMapProperty>(*It))
+				{
+					FScriptMapHelper Helper(MapProperty, MapProperty->ContainerPtrToValuePtr<void>(Obj));
+					for (FScriptMapHelper::FIterator MapIt(Helper); MapIt; ++MapIt)
+					{
+						Gather(MapProperty->KeyProp, Helper.GetKeyPtr(MapIt));
+						Gather(MapProperty->ValueProp, Helper.GetValuePtr(MapIt));
+					}
+				}
+			}
+		}
+	}
+
+	FRecursiveMemoryWriter::FRecursiveMemoryWriter(TArray<uint8>& OutBytes, const UObject* Outer)
+	  : FMemoryWriter(OutBytes, false, true),
+		OuterStack({Outer})
+	{
+		if (CVarInternNames.GetValueOnAnyThread())
+		{
+			Header.Flags |= FRecursivePayloadHeader::EFlags::NameTable;
+		}
+
+		// The table offset is patched in by Close, once the table has been written.
+		PayloadStart = Tell();
+		for (uint32 Magic : FRecursivePayloadHeader::Magic)
+		{
+			*this << Magic;
+		}
+		*this << Header.Version;
+		*this << Header.Flags;
+		*this << Header.TableOffset;
+	}
+
+	bool FRecursiveMemoryWriter::Close()
+	{
+		if (EnumHasAnyFlags(Header.Flags, FRecursivePayloadHeader::EFlags::NameTable) && !TableWritten)
+		{
+			// Paths intern their names as well, so if there are no names, nothing was written as an index, and the data
+			// reads the same without a table. Small payloads, like a single vector, then don't pay for an empty one.
+			if (Names.IsEmpty())
+			{
+				const int64 End = Tell();
+				EnumRemoveFlags(Header.Flags, FRecursivePayloadHeader::EFlags::NameTable);
+				Seek(PayloadStart + sizeof(FRecursivePayloadHeader::Magic) + sizeof(uint8));
+				*this << Header.Flags;
+				Seek(End);
+			}
+			else
+			{
+				WriteTable();
+			}
+		}
+
+		return FMemoryWriter::Close();
+	}
+
+	FArchive& FRecursiveMemoryWriter::operator<<(FName& Value)
+	{
+		if (!EnumHasAnyFlags(Header.Flags, FRecursivePayloadHeader::EFlags::NameTable) || TableWritten)
+		{
+			return FMemoryWriter::operator<<(Value);
+		}
+
+		uint32 Index = InternName(Value);
+		SerializeIntPacked(Index);
+		return *this;
+	}
+
+	uint32 FRecursiveMemoryWriter::InternName(const FName Name)
+	{
+		if (const uint32* Found = NameIndices.Find(Name))
+		{
+			return *Found;
+		}
+
+		const uint32 Index = Names.Add(Name);
+		NameIndices.Add(Name, Index);
+		return Index;
+	}
+
+	uint32 FRecursiveMemoryWriter::InternPath(const FSoftObjectPath& Path)
+	{
+		if (const uint32* Found = PathIndices.Find(Path))
+		{
+			return *Found;
+		}
+
+		// The names that make up the path are shared with the name table.
+		InternName(Path.GetAssetPath().GetPackageName());
+		InternName(Path.GetAssetPath().GetAssetName());
+
+		const uint32 Index = Paths.Add(Path);
+		PathIndices.Add(Path, Index);
+		return Index;
+	}
+
+	void FRecursiveMemoryWriter::WriteTable()
+	{
+		TableWritten = true;
+
+		const int64 TableStart = Tell();
+
+		int32 NumNames = Names.Num();
+		*this << NumNames;
+		for (FName& Name : Names)
+		{
+			*this << Name;
+		}
+
+		int32 NumPaths = Paths.Num();
+		*this << NumPaths;
+		for (const FSoftObjectPath& Path : Paths)
+		{
+			uint32 PackageIndex = NameIndices[Path.GetAssetPath().GetPackageName()];
+			uint32 AssetIndex = NameIndices[Path.GetAssetPath().GetAssetName()];
+			FString SubPath = Path.GetSubPathString();
+			SerializeIntPacked(PackageIndex);
+			SerializeIntPacked(AssetIndex);
+			*this << SubPath;
+		}
+
+		const int64 TableEnd = Tell();
 
+		// Patch the table offset into the header, which is the last field in it.
+		Header.TableOffset = IntCastChecked<uint32>(TableStart - PayloadStart);
+		Seek(PayloadStart + FRecursivePayloadHeader::Size - sizeof(uint32));
+		*this << Header.TableOffset;
+		Seek(TableEnd);
+	}
+
+	bool FRecursiveMemoryWriter::IsOwnedByWorld(const UObject* Obj)
+	{
+		const UObject* Outer = Obj->GetOuter();
+		if (!Outer)
+		{
+			return false;
+		}
+
+		if (const bool* Cached = WorldOuters.Find(Outer))
+		{
+			return *Cached;
+		}
+
+		const bool InWorld = Outer->IsA<UWorld>() || IsOwnedByWorld(Outer);
+		WorldOuters.Add(Outer, InWorld);
+		return InWorld;
+	}
+
+	bool FRecursiveMemoryWriter::ShouldExport(const UObject* Obj)
+	{
 		/*
 		 * Conditions for being exports are either:
 		 * 1. Being owned by something that is already being exported, or
 		 * 2. Being owned by a world, and therefor is not an asset from disk.
 		 */
-		const bool ShouldExport =
-			OuterStack.Contains(Obj->GetOuter()) ||
-			Obj->GetTypedOuter<UWorld>();
+		return OuterStack.Contains(Obj->GetOuter()) || IsOwnedByWorld(Obj);
+	}
+
+	FSoftObjectPath FRecursiveMemoryWriter::GetReferencePath(const UObject* Obj)
+	{
+		return FSoftObjectPath(Obj);
+	}
+
+	FArchive& FRecursiveMemoryWriter::operator<<(UObject*& Obj)
+	{
+		ERecursiveMemoryObj Op = ERecursiveMemoryObj::None;
+
+		// Nulls still write their op, so the reader stays in sync.
+		if (!IsValid(Obj))
+		{
+			*this << Op;
+			return *this;
+		}
+
+		// If this object is already being exported, then write a reference to the existing export.
+		if (const uint32* ExportIndex = ExportedObjects.Find(Obj))
+		{
+			Op = ERecursiveMemoryObj::BackReference;
+			*this << Op;
 
-		// If this object is already being exported, then prevent additional exports.
-		const bool CannotExport = ExportedObjects.Contains(Obj);
+			uint32 Index = *ExportIndex;
+			SerializeIntPacked(Index);
+			return *this;
+		}
 
-		if (ShouldExport && !CannotExport)
+		if (ShouldExport(Obj))
 		{
 			Op = ERecursiveMemoryObj::Exported;
 		}
@@ -65,20 +314,22 @@ namespace Flakes
 				*this << ObjectName;
 				*/
 
-				// Track this export, so we do not export twice.
-				ExportedObjects.Push(Obj);
+				// Track this export, so we do not export twice. This happens before serializing the object, so that
+				// references back to it from its own subobjects are resolved as well.
+				ExportedObjects.Add(Obj, ExportedObjects.Num());
 
-				OuterStack.Push(Obj); // Track that we are serializing this object
-				Obj->Serialize(*this);
-				OuterStack.Pop(); // Untrack the object
+				OuterStack.Add(Obj); // Track that we are serializing this object
+				SerializeExport(Obj);
+				OuterStack.Remove(Obj); // Untrack the object
 			}
 			break;
 		case ERecursiveMemoryObj::Reference:
 			{
-				FSoftObjectPath ExternalRef = Obj;
+				FSoftObjectPath ExternalRef = GetReferencePath(Obj);
 				*this << ExternalRef;
 			}
 			break;
+		case ERecursiveMemoryObj::BackReference:
 		default: ;
 		}
 
@@ -87,10 +338,8 @@ namespace Flakes
 
 	FArchive& FRecursiveMemoryWriter::operator<<(FObjectPtr& Obj)
 	{
-		if (UObject* ObjPtr = Obj.Get())
-		{
-			*this << ObjPtr;
-		}
+		UObject* ObjPtr = Obj.Get();
+		*this << ObjPtr;
 		return *this;
 	}
 
@@ -101,7 +350,14 @@ namespace Flakes
 
 	FArchive& FRecursiveMemoryWriter::operator<<(FSoftObjectPath& Value)
 	{
-		return FArchiveUObject::SerializeSoftObjectPath(*this, Value);
+		if (!EnumHasAnyFlags(Header.Flags, FRecursivePayloadHeader::EFlags::NameTable) || TableWritten)
+		{
+			return FArchiveUObject::SerializeSoftObjectPath(*this, Value);
+		}
+
+		uint32 Index = InternPath(Value);
+		SerializeIntPacked(Index);
+		return *this;
 	}
 
 	FArchive& FRecursiveMemoryWriter::operator<<(FWeakObjectPtr& Value)
@@ -114,8 +370,248 @@ namespace Flakes
 		return TEXT("FRecursiveMemoryWriter");
 	}
 
+	bool FRecursiveMemoryWriter::ShouldSkipProperty(const FProperty* InProperty) const
+	{
+		return BulkArrays.Contains(InProperty) || FMemoryWriter::ShouldSkipProperty(InProperty);
+	}
+
+	void FRecursiveMemoryWriter::SerializeExport(UObject* Obj)
+	{
+		SerializeWithBulkArrays(Obj->GetClass(), Obj, [&] { Obj->Serialize(*this); });
+	}
+
+	void FRecursiveMemoryWriter::SerializeWithBulkArrays(const UStruct* Struct, void* Data, const TFunctionRef<void()> SerializeFunc)
+	{
+		TArray<const FArrayProperty*, TInlineAllocator<8>> Arrays;
+		Private::GatherBulkArrays(Struct, Data, Arrays);
+
+		// The arrays are left out of the rest by ShouldSkipProperty, rather than emptied, as the source may be read by
+		// other threads, and Serialize overrides may depend on them.
+		{
+			TGuardValue<TConstArrayView<const FArrayProperty*>> BulkArraysGuard(BulkArrays, Arrays);
+			SerializeFunc();
+		}
+
+		uint32 NumArrays = Arrays.Num();
+		SerializeIntPacked(NumArrays);
+
+		int32 Alignment = CVarBulkArrayAlignment.GetValueOnAnyThread();
+		if (Alignment < 1 || Alignment > 128 || !FMath::IsPowerOfTwo(Alignment))
+		{
+			Alignment = 1;
+		}
+
+		for (const FArrayProperty* ArrayProperty : Arrays)
+		{
+			FScriptArrayHelper Helper(ArrayProperty, ArrayProperty->ContainerPtrToValuePtr<void>(Data));
+
+			FName Name = ArrayProperty->GetFName();
+			FName Type = ArrayProperty->Inner->GetClass()->GetFName();
+			int32 ElementSize = ArrayProperty->Inner->GetElementSize();
+			int32 Num = Helper.Num();
+			*this << Name;
+			*this << Type;
+			*this << ElementSize;
+			*this << Num;
+
+			// Pad so the block starts aligned, relative to the start of the payload.
+			const int64 Offset = Tell() - PayloadStart + sizeof(uint8);
+			uint8 Padding = static_cast<uint8>(Align(Offset, Alignment) - Offset);
+			*this << Padding;
+			for (uint8 i = 0; i < Padding; ++i)
+			{
+				uint8 Zero = 0;
+				*this << Zero;
+			}
+
+			Serialize(Helper.GetRawPtr(0), static_cast<int64>(Num) * ElementSize);
+		}
+	}
+
+	FRecursiveMemoryReader::FRecursiveMemoryReader(const TConstArrayView<uint8> InBytes, const bool bIsPersistent, UObject* Outer)
+	  : FRecursiveMemoryReader(InBytes, bIsPersistent, Outer, Private::FCreatedObjectsScope::Get()) {}
+
+	FRecursiveMemoryReader::FRecursiveMemoryReader(const TConstArrayView<uint8> InBytes, const bool bIsPersistent, UObject* Outer,
+		Private::FCreatedObjectsScope* Scope)
+	  : FMemoryReaderView(InBytes, bIsPersistent),
+		OuterStack({Outer}),
+		CreatedObjectsScope(Scope)
+	{
+		if (CreatedObjectsScope)
+		{
+			CreatedObjectsScope->MarkRecorded();
+			ReuseSubobjects = CreatedObjectsScope->ShouldReuseSubobjects();
+		}
+
+		ReadHeaderAndTable();
+	}
+
+	void FRecursiveMemoryReader::ReadHeaderAndTable()
+	{
+		Header.Version = static_cast<FRecursivePayloadHeader::EVersion>(0);
+
+		if (TotalSize() < FRecursivePayloadHeader::Size)
+		{
+			return;
+		}
+
+		for (const uint32 Expected : FRecursivePayloadHeader::Magic)
+		{
+			uint32 Magic = 0;
+			*this << Magic;
+			if (Magic != Expected)
+			{
+				// Legacy payload, which starts directly with the data.
+				Seek(0);
+				return;
+			}
+		}
+
+		*this << Header.Version;
+		*this << Header.Flags;
+		*this << Header.TableOffset;
+
+		if (Header.Version > FRecursivePayloadHeader::EVersion::LatestVersion)
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FRecursiveMemoryReader cannot read payload version '%u', newer than supported"), static_cast<uint32>(Header.Version))
+			SetError();
+			return;
+		}
+
+		if (!EnumHasAnyFlags(Header.Flags, FRecursivePayloadHeader::EFlags::NameTable))
+		{
+			return;
+		}
+
+		if (Header.TableOffset < FRecursivePayloadHeader::Size || Header.TableOffset > TotalSize())
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FRecursiveMemoryReader found invalid name table offset"))
+			SetError();
+			return;
+		}
+
+		const int64 DataStart = Tell();
+		Seek(Header.TableOffset);
+
+		int32 NumNames = 0;
+		*this << NumNames;
+		if (NumNames < 0 || NumNames > TotalSize() - Tell())
+		{
+			SetError();
+			return;
+		}
+
+		// Read these through the base archive, as the table itself isn't indexed.
+		Names.SetNum(NumNames);
+		for (FName& Name : Names)
+		{
+			FMemoryReaderView::operator<<(Name);
+		}
+
+		int32 NumPaths = 0;
+		*this << NumPaths;
+		if (NumPaths < 0 || NumPaths > TotalSize() - Tell())
+		{
+			SetError();
+			return;
+		}
+
+		Paths.Reserve(NumPaths);
+		for (int32 i = 0; i < NumPaths; ++i)
+		{
+			uint32 PackageIndex = 0;
+			uint32 AssetIndex = 0;
+			FString SubPath;
+			SerializeIntPacked(PackageIndex);
+			SerializeIntPacked(AssetIndex);
+			*this << SubPath;
+
+			if (!Names.IsValidIndex(PackageIndex) || !Names.IsValidIndex(AssetIndex))
+			{
+				SetError();
+				return;
+			}
+
+			FSoftObjectPath& Path = Paths.Emplace_GetRef(FTopLevelAssetPath(Names[PackageIndex], Names[AssetIndex]), MoveTemp(SubPath));
+
+			// Apply the fixups that FArchiveUObject::SerializeSoftObjectPath would have, once per path in the table.
+			if (IsPersistent())
+			{
+				Path.FixupCoreRedirects();
+			}
+#if WITH_EDITOR
+			if (IsPersistent())
+			{
+				Path.PostLoadPath(this);
+			}
+			if (GetPortFlags() & PPF_DuplicateForPIE)
+			{
+				Path.FixupForPIE();
+			}
+#endif
+		}
+
+		Seek(DataStart);
+	}
+
+	bool FRecursiveMemoryReader::GatherPaths(const TConstArrayView<uint8> InBytes, TArray<FSoftObjectPath>& OutPaths)
+	{
+		// Only the table is read, so the reader stays out of any created objects scope the caller is in.
+		const FRecursiveMemoryReader Reader(InBytes, false, nullptr, nullptr);
+		if (Reader.IsError() || !EnumHasAnyFlags(Reader.Header.Flags, FRecursivePayloadHeader::EFlags::NameTable))
+		{
+			return false;
+		}
+
+		OutPaths.Append(Reader.Paths);
+		return true;
+	}
+
+	UObject* FRecursiveMemoryReader::ResolvePath(const FSoftObjectPath& Path)
+	{
+		// Failed loads are cached as well, so a missing asset is only searched for once.
+		if (const TWeakObjectPtr<UObject>* Found = ResolvedPaths.Find(Path))
+		{
+			if (UObject* Object = Found->Get(); Object || Found->IsExplicitlyNull())
+			{
+				return Object;
+			}
+		}
+
+		UObject* Object = Path.TryLoad();
+		ResolvedPaths.Add(Path, Object);
+		return Object;
+	}
+
+	FArchive& FRecursiveMemoryReader::operator<<(FName& Value)
+	{
+		if (!EnumHasAnyFlags(Header.Flags, FRecursivePayloadHeader::EFlags::NameTable))
+		{
+			return FMemoryReaderView::operator<<(Value);
+		}
+
+		uint32 Index = 0;
+		SerializeIntPacked(Index);
+
+		if (Names.IsValidIndex(Index))
+		{
+			Value = Names[Index];
+		}
+		else
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FRecursiveMemoryReader encountered invalid name index: '%u'"), Index)
+			Value = NAME_None;
+			SetError();
+		}
+
+		return *this;
+	}
+
 	FArchive& FRecursiveMemoryReader::operator<<(UObject*& Obj)
 	{
+		// The object in this slot before it was read, in case it gets replaced.
+		UObject* const Previous = Obj;
+
 		ERecursiveMemoryObj Op;
 		*this << Op;
 
@@ -135,11 +631,28 @@ namespace Flakes
 					UE_LOG(LogFlakes, Error, TEXT("FRecursiveMemoryReader failed to load Class: Null Path"))
 					SetError();
 				}
-				else if (const UClass* ObjClass = Class.TryLoadClass<UObject>())
+				else if (const UClass* ObjClass = Cast<UClass>(ResolvePath(Class)))
 				{
-					Obj = NewObject<UObject>(OuterStack.Last(), ObjClass/*, ObjectName*/);
+					// Read back into the object already in this slot, if it can be reused, and hasn't been read into
+					// by an earlier reference to it.
+					if (ReuseSubobjects && IsValid(Obj) && Obj->GetClass() == ObjClass &&
+						Obj->GetOuter() == OuterStack.Last() && !ReusedObjects.Contains(Obj))
+					{
+						ReusedObjects.Add(Obj);
+						Private::ResetToClassDefaults(Obj);
+					}
+					else
+					{
+						Obj = NewObject<UObject>(OuterStack.Last(), ObjClass/*, ObjectName*/);
+					}
+
+					ImportedObjects.Add(Obj);
+					if (CreatedObjectsScope)
+					{
+						CreatedObjectsScope->Add(Obj);
+					}
 					OuterStack.Push(Obj);
-					Obj->Serialize(*this);
+					SerializeExport(Obj);
 					OuterStack.Pop();
 				}
 				else
@@ -153,19 +666,45 @@ namespace Flakes
 			{
 				FSoftObjectPath ExternalRef;
 				*this << ExternalRef;
-				Obj = ExternalRef.TryLoad();
+				Obj = ResolvePath(ExternalRef);
+			}
+			break;
+		case ERecursiveMemoryObj::BackReference:
+			{
+				uint32 Index = 0;
+				SerializeIntPacked(Index);
+
+				if (ImportedObjects.IsValidIndex(Index))
+				{
+					Obj = ImportedObjects[Index];
+				}
+				else
+				{
+					UE_LOG(LogFlakes, Error, TEXT("FRecursiveMemoryReader encountered invalid back-reference: '%u'"), Index)
+					SetError();
+				}
 			}
 			break;
 		case ERecursiveMemoryObj::None:
+			Obj = nullptr;
+			break;
 		default: return *this;
 		}
 
+		// Subobjects of ours that were replaced may now be stale, unless they are read into another slot later on.
+		if (CreatedObjectsScope && CreatedObjectsScope->ShouldReconcileSubobjects() &&
+			Previous != Obj && IsValid(Previous) && Previous->GetOuter() == OuterStack.Last())
+		{
+			CreatedObjectsScope->AddReplaced(Previous);
+		}
+
 		return *this;
 	}
 
 	FArchive& FRecursiveMemoryReader::operator<<(FObjectPtr& Obj)
 	{
-		UObject* RawObj = nullptr;
+		// Pass along the current value, so the object in this slot can be reused.
+		UObject* RawObj = Obj.Get();
 		*this << RawObj;
 		Obj = RawObj;
 		return *this;
@@ -178,7 +717,26 @@ namespace Flakes
 
 	FArchive& FRecursiveMemoryReader::operator<<(FSoftObjectPath& Value)
 	{
-		return FArchiveUObject::SerializeSoftObjectPath(*this, Value);
+		if (!EnumHasAnyFlags(Header.Flags, FRecursivePayloadHeader::EFlags::NameTable))
+		{
+			return FArchiveUObject::SerializeSoftObjectPath(*this, Value);
+		}
+
+		uint32 Index = 0;
+		SerializeIntPacked(Index);
+
+		if (Paths.IsValidIndex(Index))
+		{
+			Value = Paths[Index];
+		}
+		else
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FRecursiveMemoryReader encountered invalid path index: '%u'"), Index)
+			Value.Reset();
+			SetError();
+		}
+
+		return *this;
 	}
 
 	FArchive& FRecursiveMemoryReader::operator<<(FWeakObjectPtr& Value)
@@ -190,4 +748,86 @@ namespace Flakes
 	{
 		return TEXT("FRecursiveMemoryReader");
 	}
+
+	void FRecursiveMemoryReader::SerializeExport(UObject* Obj)
+	{
+		// Containers are emptied before they're read, so the subobjects in them are never seen being replaced one slot at
+		// a time. Instead, those that are no longer in any container afterward are reported as replaced.
+		const bool Reconcile = CreatedObjectsScope && CreatedObjectsScope->ShouldReconcileSubobjects();
+		TArray<UObject*> Contained;
+		if (Reconcile)
+		{
+			Private::GatherContainedSubobjects(Obj, Contained);
+		}
+
+		SerializeWithBulkArrays(Obj->GetClass(), Obj, [&] { Obj->Serialize(*this); });
+
+		if (!Contained.IsEmpty())
+		{
+			TArray<UObject*> Remaining;
+			Private::GatherContainedSubobjects(Obj, Remaining);
+			const TSet<UObject*> Kept(Remaining);
+			for (UObject* Object : Contained)
+			{
+				if (!Kept.Contains(Object))
+				{
+					CreatedObjectsScope->AddReplaced(Object);
+				}
+			}
+		}
+	}
+
+	void FRecursiveMemoryReader::SerializeWithBulkArrays(const UStruct* Struct, void* Data, const TFunctionRef<void()> SerializeFunc)
+	{
+		SerializeFunc();
+
+		if (Header.Version < FRecursivePayloadHeader::EVersion::BulkArrays || IsError())
+		{
+			return;
+		}
+
+		uint32 NumArrays = 0;
+		SerializeIntPacked(NumArrays);
+
+		for (uint32 ArrayIndex = 0; ArrayIndex < NumArrays && !IsError(); ++ArrayIndex)
+		{
+			FName Name;
+			FName Type;
+			int32 ElementSize = 0;
+			int32 Num = 0;
+			uint8 Padding = 0;
+			*this << Name;
+			*this << Type;
+			*this << ElementSize;
+			*this << Num;
+			*this << Padding;
+
+			const int64 Bytes = static_cast<int64>(Num) * ElementSize;
+			if (Num < 0 || ElementSize <= 0 || Padding + Bytes > TotalSize() - Tell())
+			{
+				UE_LOG(LogFlakes, Error, TEXT("FRecursiveMemoryReader read an invalid bulk array: '%s'"), *Name.ToString())
+				SetError();
+				return;
+			}
+			Seek(Tell() + Padding);
+
+			const FArrayProperty* ArrayProperty = FindFProperty<FArrayProperty>(Struct, Name);
+			// The type is checked along with the size, so that an int is never read back as the bits of a float.
+			if (!ArrayProperty || !Private::IsBulkElement(ArrayProperty->Inner) ||
+				ArrayProperty->Inner->GetClass()->GetFName() != Type || ArrayProperty->Inner->GetElementSize() != ElementSize)
+			{
+				UE_LOG(LogFlakes, Warning, TEXT("FRecursiveMemoryReader skipped bulk array '%s', which no longer matches '%s'"),
+					*Name.ToString(), *Struct->GetName())
+				Seek(Tell() + Bytes);
+				continue;
+			}
+
+			FScriptArrayHelper Helper(ArrayProperty, ArrayProperty->ContainerPtrToValuePtr<void>(Data));
+			Helper.EmptyAndAddUninitializedValues(Num);
+			if (Num > 0)
+			{
+				Serialize(Helper.GetRawPtr(0), Bytes);
+			}
+		}
+	}
 }
\ No newline at end of file
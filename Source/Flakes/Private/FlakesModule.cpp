@@ -1,56 +1,172 @@
 ﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved..
 
 #include "FlakesModule.h"
+#include "FlakesInterface.h"
+#include "Engine/StreamableManager.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/ScopeRWLock.h"
 #include "Modules/ModuleManager.h"
 #include "Providers/FlakesBinarySerializer.h"
+#include "Providers/FlakesFastBinarySerializer.h"
 #include "Providers/FlakesNetBinarySerializer.h"
+#include "Providers/FlakesPodSerializer.h"
 
 #define LOCTEXT_NAMESPACE "FlakesModule"
 
 const static FLazyName ModuleName("Flakes");
 
+// Cached while the module is loaded, so Get doesn't go through the module manager on every call.
+static FFlakesModule* LoadedModule = nullptr;
+
+FFlakesProviderHandle::FFlakesProviderHandle(const FName ProviderName)
+  : Name(ProviderName),
+	Provider(FFlakesModule::Get().FindSerializationProvider(ProviderName)) {}
+
+FFlakesProviderPtr FFlakesProviderHandle::Pin() const
+{
+	if (FFlakesProviderPtr Pinned = Provider.Pin())
+	{
+		return Pinned;
+	}
+
+	// The provider was removed, or never registered, so check if one has been added since.
+	return FFlakesModule::Get().FindSerializationProvider(Name);
+}
+
 FFlakesModule& FFlakesModule::Get()
 {
+	if (LIKELY(LoadedModule))
+	{
+		return *LoadedModule;
+	}
+
 	return FModuleManager::Get().LoadModuleChecked<FFlakesModule>(ModuleName);
 }
 
 void FFlakesModule::StartupModule()
 {
+	LoadedModule = this;
+
 	AddSerializationProvider(MakeUnique<Flakes::Binary::Type>());
 	AddSerializationProvider(MakeUnique<Flakes::NetBinary::Type>());
+	AddSerializationProvider(MakeUnique<Flakes::FastBinary::Type>());
+	AddSerializationProvider(MakeUnique<Flakes::Pod::Type>());
 }
 
 void FFlakesModule::ShutdownModule()
 {
+	LoadedModule = nullptr;
+
+	StreamableManager.Reset();
+
+	FScopeLock Lock(&ProviderLock);
+	ProviderTable = nullptr;
+	ProviderTables.Empty();
+	SerializationProviders.Empty();
 }
 
 TArray<FName> FFlakesModule::GetAllProviderNames() const
 {
 	TArray<FName> Out;
-	SerializationProviders.GetKeys(Out);
+	if (const FProviderTable* Table = ProviderTable.load(std::memory_order_acquire))
+	{
+		Table->Providers.GetKeys(Out);
+	}
 	return Out;
 }
 
 void FFlakesModule::AddSerializationProvider(TUniquePtr<Flakes::ISerializationProvider>&& Provider)
 {
-	SerializationProviders.Add(Provider->GetProviderName(), MoveTemp(Provider));
+	check(Provider.IsValid());
+
+	FScopeLock Lock(&ProviderLock);
+	const FName ProviderName = Provider->GetProviderName();
+	SerializationProviders.Add(ProviderName, MakeShareable(Provider.Release()));
+	PublishProviderTable();
 }
 
 void FFlakesModule::RemoveSerializationProvider(const FName ProviderName)
 {
-	SerializationProviders.Remove(ProviderName);
+	// Calls already using the provider keep it alive until they finish.
+	FScopeLock Lock(&ProviderLock);
+	if (SerializationProviders.Remove(ProviderName))
+	{
+		PublishProviderTable();
+	}
 }
 
 bool FFlakesModule::UseSerializationProvider(const FName ProviderName, const FSerializationProviderExec& Exec) const
 {
-	if (const TUniquePtr<Flakes::ISerializationProvider>* Found = SerializationProviders.Find(ProviderName))
+	if (const FFlakesProviderPtr Provider = FindSerializationProvider(ProviderName))
 	{
-		Exec(Found->Get());
+		Exec(Provider.Get());
 		return true;
 	}
 	return false;
 }
 
+FFlakesProviderPtr FFlakesModule::FindSerializationProvider(const FName ProviderName) const
+{
+	if (const FProviderTable* Table = ProviderTable.load(std::memory_order_acquire))
+	{
+		if (const TWeakPtr<Flakes::ISerializationProvider, ESPMode::ThreadSafe>* Found = Table->Providers.Find(ProviderName))
+		{
+			return Found->Pin();
+		}
+	}
+	return nullptr;
+}
+
+void FFlakesModule::PublishProviderTable()
+{
+	TUniquePtr<FProviderTable> Table = MakeUnique<FProviderTable>();
+	Table->Providers.Reserve(SerializationProviders.Num());
+	for (auto&& Provider : SerializationProviders)
+	{
+		Table->Providers.Add(Provider.Key, Provider.Value);
+	}
+
+	ProviderTable.store(Table.Get(), std::memory_order_release);
+	ProviderTables.Add(MoveTemp(Table));
+}
+
+void FFlakesModule::AddDictionary(const FFlakesDictionary& Dictionary)
+{
+	if (!ensureMsgf(Dictionary.IsValid(), TEXT("Cannot add invalid dictionary '%s'"), *Dictionary.Name.ToString()))
+	{
+		return;
+	}
+
+	FWriteScopeLock Lock(DictionaryLock);
+	Dictionaries.Add(Dictionary.Id, MakeShared<const FFlakesDictionary, ESPMode::ThreadSafe>(Dictionary));
+}
+
+void FFlakesModule::RemoveDictionary(const uint32 DictionaryId)
+{
+	// Decoders still holding the dictionary keep it alive until they finish.
+	FWriteScopeLock Lock(DictionaryLock);
+	Dictionaries.Remove(DictionaryId);
+}
+
+FFlakesDictionaryPtr FFlakesModule::FindDictionary(const uint32 DictionaryId) const
+{
+	FReadScopeLock Lock(DictionaryLock);
+	if (const TSharedRef<const FFlakesDictionary, ESPMode::ThreadSafe>* Found = Dictionaries.Find(DictionaryId))
+	{
+		return *Found;
+	}
+	return nullptr;
+}
+
+FStreamableManager& FFlakesModule::GetStreamableManager()
+{
+	if (!StreamableManager.IsValid())
+	{
+		StreamableManager = MakeUnique<FStreamableManager>();
+	}
+	return *StreamableManager;
+}
+
 #undef LOCTEXT_NAMESPACE
 
 IMPLEMENT_MODULE(FFlakesModule, Flakes)
\ No newline at end of file
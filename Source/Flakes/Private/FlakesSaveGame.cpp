@@ -9,21 +9,29 @@
 void UFlakesSaveGame::SetObjectToSave(UObject* Obj)
 {
 	Flake = Flakes::MakeFlake<Flakes::Binary::Type>(Obj);
+	LazyFlake = {};
 }
 
 void UFlakesSaveGame::SetStructToSave(const FInstancedStruct& Data)
 {
 	Flake = Flakes::MakeFlake<Flakes::Binary::Type>(FConstStructView(Data), nullptr);
+	LazyFlake = {};
+}
+
+void UFlakesSaveGame::SetLazyFlakeToSave(const Flakes::FLazyFlake& InFlake)
+{
+	Flake = FFlake();
+	LazyFlake = InFlake;
 }
 
 UObject* UFlakesSaveGame::LoadObjectFromData(UObject* Outer) const
 {
-	return Flakes::CreateObject<Flakes::Binary::Type>(Flake, UObject::StaticClass(), Outer);
+	return Flakes::CreateObject<Flakes::Binary::Type>(GetFlake(), UObject::StaticClass(), Outer);
 }
 
 UObject* UFlakesSaveGame::LoadObjectFromDataClassChecked(UObject* Outer, const UClass* ExpectedClass) const
 {
-	if (auto&& Obj = Flakes::CreateObject<Flakes::Binary::Type>(Flake, ExpectedClass, Outer))
+	if (auto&& Obj = Flakes::CreateObject<Flakes::Binary::Type>(GetFlake(), ExpectedClass, Outer))
 	{
 		return Obj;
 	}
@@ -31,8 +39,20 @@ UObject* UFlakesSaveGame::LoadObjectFromDataClassChecked(UObject* Outer, const U
 	return nullptr;
 }
 
+const FFlake& UFlakesSaveGame::GetFlake() const
+{
+	return LazyFlake.IsSet() ? LazyFlake.Get() : Flake;
+}
+
 void UFlakesSaveGame::Serialize(FArchive& Ar)
 {
+	// Resolve before the flake property is saved with the rest.
+	if (Ar.IsSaving() && LazyFlake.IsSet())
+	{
+		Flake = LazyFlake.Get();
+		LazyFlake = {};
+	}
+
 	Super::Serialize(Ar);
 
 	UE_LOG(LogFlakes, Log, TEXT("Serialize for RoseSaveFile called with Archive in state: %s"),
@@ -0,0 +1,384 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesSerializationPlan.h"
+#include "FlakesLogging.h"
+#include "FlakesTypeCache.h"
+#include "Algo/AllOf.h"
+#include "Serialization/StructuredArchive.h"
+#include "UObject/EnumProperty.h"
+#include "UObject/SoftObjectPtr.h"
+#include "UObject/UnrealType.h"
+
+namespace Flakes::Plan
+{
+	namespace Private
+	{
+		// Properties that tagged serialization wouldn't save either.
+		constexpr EPropertyFlags SkippedFlags = CPF_Transient | CPF_Deprecated | CPF_SkipSerialization;
+
+		bool IsPodStruct(const UScriptStruct* Struct)
+		{
+			if (Struct->StructFlags & STRUCT_IsPlainOldData)
+			{
+				// Native ops can report plain-old-data for a struct holding raw object pointers, which must never be
+				// copied as addresses. RefLink chains every property that can reference an object.
+				return Struct->RefLink == nullptr;
+			}
+
+			// Native structs can have members that aren't properties, such as a vtable, or a cache, which a copy of the
+			// whole struct would overwrite. Their properties are compiled one at a time instead, and only add up to a
+			// single memcpy if they cover the struct.
+			if (Struct->GetCppStructOps())
+			{
+				return false;
+			}
+
+			for (TFieldIterator<FProperty> It(Struct); It; ++It)
+			{
+				if (It->HasAnyPropertyFlags(SkippedFlags) || !IsPodProperty(*It))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		uint32 HashLayout(const UStruct* Struct);
+
+		// Hash of the type of a single value of a property, including the layout of structs, so that a memcpy is only
+		// trusted to read back into the same types it was written from.
+		uint32 HashValue(const FProperty* Property)
+		{
+			uint32 Hash = HashCombineFast(GetTypeHash(Property->GetClass()->GetFName()), GetTypeHash(Property->GetElementSize()));
+
+			if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+			{
+				Hash = HashCombineFast(Hash, HashLayout(StructProperty->Struct));
+			}
+			else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+			{
+				Hash = HashCombineFast(Hash, HashValue(ArrayProperty->Inner));
+			}
+
+			return Hash;
+		}
+
+		// Hash of the names, types, and offsets of every saved property of a struct, and of the structs inside it.
+		uint32 HashLayout(const UStruct* Struct)
+		{
+			uint32 Hash = GetTypeHash(Struct->GetPropertiesSize());
+
+			for (TFieldIterator<FProperty> It(Struct); It; ++It)
+			{
+				const FProperty* Property = *It;
+				if (Property->HasAnyPropertyFlags(SkippedFlags))
+				{
+					continue;
+				}
+
+				Hash = HashCombineFast(Hash, GetTypeHash(Property->GetFName()));
+				Hash = HashCombineFast(Hash, GetTypeHash(Property->GetOffset_ForInternal()));
+				Hash = HashCombineFast(Hash, GetTypeHash(Property->GetArrayDim()));
+				Hash = HashCombineFast(Hash, HashValue(Property));
+			}
+
+			return Hash;
+		}
+
+		void AddMemcpy(FPlan& Plan, const int32 Offset, const int32 Size)
+		{
+			// Merge with the previous span, if this continues it exactly. Padding is never copied.
+			if (!Plan.Ops.IsEmpty())
+			{
+				FOp& Last = Plan.Ops.Last();
+				if (Last.Op == EOp::Memcpy && Last.Offset + Last.Size == Offset)
+				{
+					Last.Size += Size;
+					return;
+				}
+			}
+
+			FOp& Op = Plan.Ops.AddDefaulted_GetRef();
+			Op.Op = EOp::Memcpy;
+			Op.Offset = Offset;
+			Op.Size = Size;
+		}
+
+		bool IsFlat(const FPlan& Plan)
+		{
+			return Algo::AllOf(Plan.Ops, [](const FOp& Op)
+				{
+					switch (Op.Op)
+					{
+					case EOp::Memcpy:
+					case EOp::Bool:
+					case EOp::String:
+						return true;
+					case EOp::Array:
+						return Op.Element->IsFlat;
+					default:
+						return false;
+					}
+				});
+		}
+
+		void CompileProperties(const UStruct* Struct, int32 Offset, FPlan& Plan);
+
+		// Compiles a single value of a property, at Offset from the start of the plan's container.
+		void CompileValue(const FProperty* Property, const int32 Offset, FPlan& Plan)
+		{
+			// Never true for native structs that aren't plain-old-data, so their element size is never copied as one block.
+			if (IsPodProperty(Property))
+			{
+				AddMemcpy(Plan, Offset, Property->GetElementSize());
+				return;
+			}
+
+			FOp Op;
+			Op.Offset = Offset;
+			Op.Property = Property;
+
+			if (Property->IsA<FBoolProperty>())
+			{
+				Op.Op = EOp::Bool;
+			}
+			else if (Property->IsA<FStrProperty>())
+			{
+				Op.Op = EOp::String;
+			}
+			else if (Property->IsA<FNameProperty>())
+			{
+				Op.Op = EOp::Name;
+			}
+			else if (Property->IsA<FObjectProperty>())
+			{
+				Op.Op = EOp::Object;
+			}
+			else if (Property->IsA<FSoftObjectProperty>())
+			{
+				Op.Op = EOp::SoftObject;
+			}
+			else if (Property->IsA<FWeakObjectProperty>())
+			{
+				Op.Op = EOp::WeakObject;
+			}
+			else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+			{
+				const TSharedRef<FPlan> Element = MakeShared<FPlan>();
+				CompileValue(ArrayProperty->Inner, 0, *Element);
+				Element->Size = ArrayProperty->Inner->GetElementSize();
+				Element->IsPod = Element->Ops.Num() == 1 && Element->Ops[0].Op == EOp::Memcpy &&
+					Element->Ops[0].Size == Element->Size;
+				Element->IsFlat = IsFlat(*Element);
+
+				// The element plan only hashes what it doesn't copy as raw bytes, so the inner type is hashed as well.
+				Plan.LayoutHash = HashCombineFast(Plan.LayoutHash, HashValue(ArrayProperty->Inner));
+				Plan.LayoutHash = HashCombineFast(Plan.LayoutHash, Element->LayoutHash);
+				Op.Op = EOp::Array;
+				Op.Element = Element;
+			}
+			else if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+			{
+				if (!(StructProperty->Struct->StructFlags & STRUCT_SerializeNative))
+				{
+					// Inline the struct's own properties.
+					CompileProperties(StructProperty->Struct, Offset, Plan);
+					return;
+				}
+
+				Plan.LayoutHash = HashCombineFast(Plan.LayoutHash, GetTypeHash(StructProperty->Struct->GetFName()));
+				Op.Op = EOp::NativeStruct;
+				Op.Struct = StructProperty->Struct;
+			}
+			else
+			{
+				Op.Op = EOp::Generic;
+			}
+
+			Plan.Ops.Add(Op);
+		}
+
+		void CompileProperties(const UStruct* Struct, const int32 Offset, FPlan& Plan)
+		{
+			for (TFieldIterator<FProperty> It(Struct); It; ++It)
+			{
+				const FProperty* Property = *It;
+				if (Property->HasAnyPropertyFlags(SkippedFlags))
+				{
+					continue;
+				}
+
+				const int32 PropertyOffset = Offset + Property->GetOffset_ForInternal();
+
+				Plan.LayoutHash = HashCombineFast(Plan.LayoutHash, GetTypeHash(Property->GetFName()));
+				Plan.LayoutHash = HashCombineFast(Plan.LayoutHash, GetTypeHash(PropertyOffset));
+				Plan.LayoutHash = HashCombineFast(Plan.LayoutHash, GetTypeHash(Property->GetArrayDim()));
+				Plan.LayoutHash = HashCombineFast(Plan.LayoutHash, HashValue(Property));
+
+				for (int32 Index = 0; Index < Property->GetArrayDim(); ++Index)
+				{
+					CompileValue(Property, PropertyOffset + Index * Property->GetElementSize(), Plan);
+				}
+			}
+		}
+
+		TSharedRef<const FPlan> Compile(const UStruct* Struct)
+		{
+			const TSharedRef<FPlan> Plan = MakeShared<FPlan>();
+			Plan->Size = Struct->GetPropertiesSize();
+
+			const UScriptStruct* ScriptStruct = Cast<UScriptStruct>(Struct);
+			if (ScriptStruct && IsPodStruct(ScriptStruct))
+			{
+				// This includes structs whose native ops report plain-old-data, even if they have their own Serialize.
+				AddMemcpy(*Plan, 0, Plan->Size);
+				Plan->LayoutHash = HashLayout(Struct);
+			}
+			else if (ScriptStruct && (ScriptStruct->StructFlags & STRUCT_SerializeNative))
+			{
+				// Structs with their own Serialize are the one thing that can't be inlined.
+				FOp& Op = Plan->Ops.AddDefaulted_GetRef();
+				Op.Op = EOp::NativeStruct;
+				Op.Struct = const_cast<UScriptStruct*>(ScriptStruct);
+				Plan->LayoutHash = GetTypeHash(Struct->GetFName());
+			}
+			else
+			{
+				CompileProperties(Struct, 0, *Plan);
+			}
+
+			Plan->IsPod = Plan->Ops.Num() == 1 && Plan->Ops[0].Op == EOp::Memcpy && Plan->Ops[0].Offset == 0 &&
+				Plan->Ops[0].Size == Plan->Size;
+			Plan->IsFlat = IsFlat(*Plan);
+
+			return Plan;
+		}
+
+		void ExecuteArray(FArchive& Ar, const FOp& Op, void* Data)
+		{
+			const FPlan& Element = *Op.Element;
+			FScriptArrayHelper Helper(static_cast<const FArrayProperty*>(Op.Property), Data);
+
+			int32 Num = Helper.Num();
+			Ar << Num;
+
+			if (Ar.IsLoading())
+			{
+				// Don't trust the count further than the bytes that are left to read it from.
+				if (Num < 0 || (Element.IsPod && static_cast<int64>(Num) * Element.Size > Ar.TotalSize() - Ar.Tell()))
+				{
+					UE_LOG(LogFlakes, Error, TEXT("Serialization plan read an invalid array size: %i"), Num)
+					Ar.SetError();
+					return;
+				}
+
+				Helper.EmptyAndAddValues(Num);
+			}
+
+			if (Num == 0)
+			{
+				return;
+			}
+
+			if (Element.IsPod)
+			{
+				Ar.Serialize(Helper.GetRawPtr(0), static_cast<int64>(Num) * Element.Size);
+				return;
+			}
+
+			for (int32 Index = 0; Index < Num && !Ar.IsError(); ++Index)
+			{
+				Element.Execute(Ar, Helper.GetRawPtr(Index));
+			}
+		}
+
+		TTypeCache<UStruct, FPlan> Plans;
+	}
+
+	void FPlan::Execute(FArchive& Ar, void* Container) const
+	{
+		uint8* Base = static_cast<uint8*>(Container);
+
+		for (const FOp& Op : Ops)
+		{
+			void* Data = Base + Op.Offset;
+
+			switch (Op.Op)
+			{
+			case EOp::Memcpy:
+				Ar.Serialize(Data, Op.Size);
+				break;
+			case EOp::Bool:
+				{
+					const FBoolProperty* BoolProperty = static_cast<const FBoolProperty*>(Op.Property);
+					uint8 Value = BoolProperty->GetPropertyValue(Data);
+					Ar << Value;
+					if (Ar.IsLoading())
+					{
+						BoolProperty->SetPropertyValue(Data, Value != 0);
+					}
+				}
+				break;
+			case EOp::String:
+				Ar << *static_cast<FString*>(Data);
+				break;
+			case EOp::Name:
+				Ar << *static_cast<FName*>(Data);
+				break;
+			case EOp::Object:
+				Ar << *static_cast<FObjectPtr*>(Data);
+				break;
+			case EOp::SoftObject:
+				Ar << *static_cast<FSoftObjectPtr*>(Data);
+				break;
+			case EOp::WeakObject:
+				Ar << *static_cast<FWeakObjectPtr*>(Data);
+				break;
+			case EOp::Array:
+				Private::ExecuteArray(Ar, Op, Data);
+				break;
+			case EOp::NativeStruct:
+				Op.Struct->SerializeItem(Ar, Data, nullptr);
+				break;
+			case EOp::Generic:
+				{
+					FStructuredArchiveFromArchive Structured(Ar);
+					Op.Property->SerializeItem(Structured.GetSlot(), Data, nullptr);
+				}
+				break;
+			default: ;
+			}
+
+			if (Ar.IsError())
+			{
+				return;
+			}
+		}
+	}
+
+	TSharedRef<const FPlan> GetPlan(const UStruct* Struct)
+	{
+		return Private::Plans.FindOrBuild(Struct, &Private::Compile);
+	}
+
+	bool IsPodProperty(const FProperty* Property)
+	{
+		if (Property->IsA<FNumericProperty>() || Property->IsA<FEnumProperty>())
+		{
+			return true;
+		}
+
+		if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+		{
+			return BoolProperty->IsNativeBool();
+		}
+
+		if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+		{
+			return Private::IsPodStruct(StructProperty->Struct);
+		}
+
+		return false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,192 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesSnapshot.h"
+#include "FlakesLogging.h"
+#include "FlakesMemory.h"
+#include "Providers/FlakesFastBinarySerializer.h"
+#include "UObject/GarbageCollection.h"
+#include "UObject/UObjectHash.h"
+
+namespace Flakes::Private
+{
+	namespace Snapshot
+	{
+		// Properties that aren't saved, so they don't need copying.
+		constexpr EPropertyFlags SkippedFlags = CPF_Transient | CPF_Deprecated | CPF_SkipSerialization;
+
+		// Writes exported objects from their copies, instead of the objects themselves. Nothing is read from the live
+		// objects, other than their class.
+		class FSnapshotWriter : public FRecursiveMemoryWriter
+		{
+		public:
+			using FCopies = TMap<const UObject*, TPair<uint8*, const UObject*>>;
+
+			FSnapshotWriter(TArray<uint8>& OutBytes, const UObject* Outer, const FCopies& Copies,
+				const TMap<const UObject*, FSoftObjectPath>& Paths)
+			  : FRecursiveMemoryWriter(OutBytes, Outer),
+				Copies(Copies),
+				Paths(Paths) {}
+
+			virtual void SerializeExport(UObject* Obj) override
+			{
+				if (const TPair<uint8*, const UObject*>* Copy = Copies.Find(Obj))
+				{
+					FastBinary::SerializeWithPlan(*this, Obj->GetClass(), Copy->Key);
+				}
+				else
+				{
+					UE_LOG(LogFlakes, Error, TEXT("FObjectSnapshot: '%s' was exported, but not copied"), *Obj->GetName())
+					SetError();
+				}
+			}
+
+		protected:
+			virtual bool ShouldExport(const UObject* Obj) override
+			{
+				// Only objects that were owned by the root when the snapshot was made have copies to export.
+				const TPair<uint8*, const UObject*>* Copy = Copies.Find(Obj);
+				return Copy && IsExporting(Copy->Value);
+			}
+
+			virtual FSoftObjectPath GetReferencePath(const UObject* Obj) override
+			{
+				if (const FSoftObjectPath* Path = Paths.Find(Obj))
+				{
+					return *Path;
+				}
+
+				// Weak references aren't gathered, so they fall back to the live path.
+				return FRecursiveMemoryWriter::GetReferencePath(Obj);
+			}
+
+		private:
+			const FCopies& Copies;
+			const TMap<const UObject*, FSoftObjectPath>& Paths;
+		};
+
+		// Gathers every object referenced by the properties of a copy.
+		class FReferenceGatherer : public FReferenceCollector
+		{
+		public:
+			explicit FReferenceGatherer(TSet<const UObject*>& OutObjects)
+			  : Objects(OutObjects) {}
+
+			virtual void HandleObjectReference(UObject*& Object, const UObject* ReferencingObject, const FProperty* ReferencingProperty) override
+			{
+				if (Object)
+				{
+					Objects.Add(Object);
+				}
+			}
+
+			virtual bool IsIgnoringArchetypeRef() const override { return false; }
+			virtual bool IsIgnoringTransient() const override { return false; }
+
+		private:
+			TSet<const UObject*>& Objects;
+		};
+	}
+
+	FObjectSnapshot::FObjectSnapshot(const UObject* Root)
+	{
+		check(IsInGameThread());
+
+		if (!IsValid(Root))
+		{
+			return;
+		}
+
+		// Every object the writer could export is owned by the root, so copying all of them covers it.
+		TArray<UObject*> Objects;
+		Objects.Add(const_cast<UObject*>(Root));
+		GetObjectsWithOuter(Root, Objects, true);
+
+		Copies.Reserve(Objects.Num());
+		CopiesByObject.Reserve(Objects.Num());
+
+		for (UObject* Object : Objects)
+		{
+			if (!IsValid(Object))
+			{
+				continue;
+			}
+
+			const UClass* Class = Object->GetClass();
+			uint8* Memory = static_cast<uint8*>(FMemory::Malloc(Class->GetPropertiesSize(), Class->GetMinAlignment()));
+			Class->InitializeStruct(Memory);
+
+			for (TFieldIterator<FProperty> It(Class); It; ++It)
+			{
+				if (!It->HasAnyPropertyFlags(Snapshot::SkippedFlags))
+				{
+					It->CopyCompleteValue_InContainer(Memory, Object);
+				}
+			}
+
+			Copies.Add({ Object, Memory });
+			CopiesByObject.Add(Object, { Memory, Object->GetOuter() });
+		}
+
+		// Paths are made from the outer and name chain of each object, which may change after this returns.
+		TSet<const UObject*> Referenced;
+		Snapshot::FReferenceGatherer Gatherer(Referenced);
+		for (const FCopy& Copy : Copies)
+		{
+			Referenced.Add(Copy.Object);
+			Gatherer.AddPropertyReferences(Copy.Object->GetClass(), Copy.Memory);
+		}
+
+		Paths.Reserve(Referenced.Num());
+		for (const UObject* Object : Referenced)
+		{
+			Paths.Add(Object, FSoftObjectPath(Object));
+		}
+	}
+
+	FObjectSnapshot::~FObjectSnapshot()
+	{
+		for (const FCopy& Copy : Copies)
+		{
+			Copy.Object->GetClass()->DestroyStruct(Copy.Memory);
+			FMemory::Free(Copy.Memory);
+		}
+	}
+
+	void FObjectSnapshot::Encode(TArray<uint8>& OutData) const
+	{
+		if (Copies.IsEmpty())
+		{
+			return;
+		}
+
+		// Garbage collection visits the copies, and may null out their references to garbage while they're being read,
+		// so it's held off until encoding is done.
+		FGCScopeGuard GCGuard;
+
+		const UObject* Root = Copies[0].Object;
+		Snapshot::FSnapshotWriter MemoryWriter(OutData, Root, CopiesByObject, Paths);
+		MemoryWriter.SerializeExport(const_cast<UObject*>(Root));
+
+		if (MemoryWriter.IsError())
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FObjectSnapshot::Encode failed to serialized object!"));
+		}
+
+		MemoryWriter.FlushCache();
+		MemoryWriter.Close();
+	}
+
+	void FObjectSnapshot::AddReferencedObjects(FReferenceCollector& Collector)
+	{
+		for (FCopy& Copy : Copies)
+		{
+			Collector.AddReferencedObject(Copy.Object);
+			Collector.AddPropertyReferences(Copy.Object->GetClass(), Copy.Memory);
+		}
+	}
+
+	FString FObjectSnapshot::GetReferencerName() const
+	{
+		return TEXT("Flakes::Private::FObjectSnapshot");
+	}
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "UObject/GCObject.h"
+#include "UObject/SoftObjectPath.h"
+
+namespace Flakes::Private
+{
+	/*
+	 * A copy of the saved property values of an object, and every object it owns, made on the game thread, so that they
+	 * can be encoded on any thread. The outer of each copied object, and the path of every object the copies reference,
+	 * are recorded as well, so the objects are free to change, be renamed, or be moved as soon as the snapshot has been
+	 * made. Objects are only exported if they were owned by the root when the snapshot was made. Any other object is
+	 * referenced by path, including those owned by a world, which a synchronous flake would have exported.
+	 */
+	class FObjectSnapshot : public FGCObject, FNoncopyable
+	{
+	public:
+		explicit FObjectSnapshot(const UObject* Root);
+		virtual ~FObjectSnapshot() override;
+
+		// Appends the snapshot to OutData as a FastBinary payload. Blocks garbage collection while it runs, as that
+		// rewrites references in the copies.
+		void Encode(TArray<uint8>& OutData) const;
+
+		//~ Begin FGCObject Interface
+		virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+		virtual FString GetReferencerName() const override;
+		//~ End FGCObject Interface
+
+	private:
+		struct FCopy
+		{
+			TObjectPtr<UObject> Object;
+			uint8* Memory = nullptr;
+		};
+
+		TArray<FCopy> Copies;
+
+		// The copy and outer of each object owned by the root, and the path of each object the copies may reference.
+		TMap<const UObject*, TPair<uint8*, const UObject*>> CopiesByObject;
+		TMap<const UObject*, FSoftObjectPath> Paths;
+	};
+}
\ No newline at end of file
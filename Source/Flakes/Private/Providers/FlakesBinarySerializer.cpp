@@ -12,8 +12,9 @@ namespace Flakes::Binary
 		// For some reason, SerializeItem is not const, so we have to const_cast the ScriptStruct
 		// We also have to const_cast the memory because *we* know that this function only reads from it, but
 		// SerializeItem is a bidirectional serializer, so it doesn't.
-		const_cast<UScriptStruct*>(Struct.GetScriptStruct())->SerializeItem(MemoryWriter,
-			const_cast<uint8*>(Struct.GetMemory()), nullptr);
+		uint8* Memory = const_cast<uint8*>(Struct.GetMemory());
+		MemoryWriter.SerializeWithBulkArrays(Struct.GetScriptStruct(), Memory,
+			[&] { const_cast<UScriptStruct*>(Struct.GetScriptStruct())->SerializeItem(MemoryWriter, Memory, nullptr); });
 
 		if (MemoryWriter.IsError())
 		{
@@ -27,7 +28,7 @@ namespace Flakes::Binary
 	void FSerializationProvider_Binary::ReadData(const UObject* Object, TArray<uint8>& OutData)
 	{
 		FRecursiveMemoryWriter MemoryWriter(OutData, Object);
-		const_cast<UObject*>(Object)->Serialize(MemoryWriter);
+		MemoryWriter.SerializeExport(const_cast<UObject*>(Object));
 
 		if (MemoryWriter.IsError())
 		{
@@ -38,11 +39,12 @@ namespace Flakes::Binary
 		MemoryWriter.Close();
 	}
 
-	void FSerializationProvider_Binary::WriteData(const FStructView& Struct, const TArray<uint8>& Data, UObject* Outer)
+	void FSerializationProvider_Binary::WriteData(const FStructView& Struct, const TConstArrayView<uint8> Data, UObject* Outer)
 	{
 		FRecursiveMemoryReader MemoryReader(Data, true, Outer);
 		// For some reason, SerializeItem is not const, so we have to const_cast the ScriptStruct
-		const_cast<UScriptStruct*>(Struct.GetScriptStruct())->SerializeItem(MemoryReader, Struct.GetMemory(), nullptr);
+		MemoryReader.SerializeWithBulkArrays(Struct.GetScriptStruct(), Struct.GetMemory(),
+			[&] { const_cast<UScriptStruct*>(Struct.GetScriptStruct())->SerializeItem(MemoryReader, Struct.GetMemory(), nullptr); });
 
 		if (MemoryReader.IsError())
 		{
@@ -53,10 +55,10 @@ namespace Flakes::Binary
 		MemoryReader.Close();
 	}
 
-	void FSerializationProvider_Binary::WriteData(UObject* Object, const TArray<uint8>& Data)
+	void FSerializationProvider_Binary::WriteData(UObject* Object, const TConstArrayView<uint8> Data)
 	{
 		FRecursiveMemoryReader MemoryReader(Data, true, Object);
-		Object->Serialize(MemoryReader);
+		MemoryReader.SerializeExport(Object);
 
 		if (MemoryReader.IsError())
 		{
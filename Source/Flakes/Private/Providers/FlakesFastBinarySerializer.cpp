@@ -0,0 +1,109 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "Providers/FlakesFastBinarySerializer.h"
+#include "FlakesLogging.h"
+#include "FlakesMemory.h"
+#include "FlakesSerializationPlan.h"
+
+namespace Flakes::FastBinary
+{
+	namespace Private
+	{
+		class FPlanMemoryWriter : public FRecursiveMemoryWriter
+		{
+		public:
+			using FRecursiveMemoryWriter::FRecursiveMemoryWriter;
+
+			virtual void SerializeExport(UObject* Obj) override
+			{
+				SerializeWithPlan(*this, Obj->GetClass(), Obj);
+			}
+		};
+
+		class FPlanMemoryReader : public FRecursiveMemoryReader
+		{
+		public:
+			using FRecursiveMemoryReader::FRecursiveMemoryReader;
+
+			virtual void SerializeExport(UObject* Obj) override
+			{
+				SerializeWithPlan(*this, Obj->GetClass(), Obj);
+			}
+		};
+	}
+
+	void SerializeWithPlan(FArchive& Ar, const UStruct* Struct, void* Data)
+	{
+		const TSharedRef<const Plan::FPlan> Plan = Plan::GetPlan(Struct);
+
+		uint32 LayoutHash = Plan->LayoutHash;
+		Ar << LayoutHash;
+
+		if (LayoutHash != Plan->LayoutHash)
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FastBinary payload was written with a different layout of '%s'"),
+				*Struct->GetName())
+			Ar.SetError();
+			return;
+		}
+
+		Plan->Execute(Ar, Data);
+	}
+
+	void FSerializationProvider_FastBinary::ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer)
+	{
+		Private::FPlanMemoryWriter MemoryWriter(OutData, Outer);
+		// Plans are bidirectional, so the memory has to be const_cast, even though it is only read from.
+		SerializeWithPlan(MemoryWriter, Struct.GetScriptStruct(), const_cast<uint8*>(Struct.GetMemory()));
+
+		if (MemoryWriter.IsError())
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_FastBinary::ReadData failed to serialized struct!"));
+		}
+
+		MemoryWriter.FlushCache();
+		MemoryWriter.Close();
+	}
+
+	void FSerializationProvider_FastBinary::ReadData(const UObject* Object, TArray<uint8>& OutData)
+	{
+		Private::FPlanMemoryWriter MemoryWriter(OutData, Object);
+		SerializeWithPlan(MemoryWriter, Object->GetClass(), const_cast<UObject*>(Object));
+
+		if (MemoryWriter.IsError())
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_FastBinary::ReadData failed to serialized object!"));
+		}
+
+		MemoryWriter.FlushCache();
+		MemoryWriter.Close();
+	}
+
+	void FSerializationProvider_FastBinary::WriteData(const FStructView& Struct, const TConstArrayView<uint8> Data, UObject* Outer)
+	{
+		Private::FPlanMemoryReader MemoryReader(Data, true, Outer);
+		SerializeWithPlan(MemoryReader, Struct.GetScriptStruct(), Struct.GetMemory());
+
+		if (MemoryReader.IsError())
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_FastBinary::WriteData failed to serialized struct!"));
+		}
+
+		MemoryReader.FlushCache();
+		MemoryReader.Close();
+	}
+
+	void FSerializationProvider_FastBinary::WriteData(UObject* Object, const TConstArrayView<uint8> Data)
+	{
+		Private::FPlanMemoryReader MemoryReader(Data, true, Object);
+		SerializeWithPlan(MemoryReader, Object->GetClass(), Object);
+
+		if (MemoryReader.IsError())
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_FastBinary::WriteData failed to serialized object!"));
+		}
+
+		MemoryReader.FlushCache();
+		MemoryReader.Close();
+	}
+}
\ No newline at end of file
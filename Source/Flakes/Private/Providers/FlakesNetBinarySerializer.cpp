@@ -23,8 +23,9 @@ namespace Flakes::NetBinary
 		// For some reason, SerializeItem is not const, so we have to const_cast the ScriptStruct
 		// We also have to const_cast the memory because *we* know that this function only reads from it, but
 		// SerializeItem is a bidirectional serializer, so it doesn't.
-		const_cast<UScriptStruct*>(Struct.GetScriptStruct())->SerializeItem(MemoryWriter,
-			const_cast<uint8*>(Struct.GetMemory()), nullptr);
+		uint8* Memory = const_cast<uint8*>(Struct.GetMemory());
+		MemoryWriter.SerializeWithBulkArrays(Struct.GetScriptStruct(), Memory,
+			[&] { const_cast<UScriptStruct*>(Struct.GetScriptStruct())->SerializeItem(MemoryWriter, Memory, nullptr); });
 
 		if (MemoryWriter.IsError())
 		{
@@ -39,7 +40,7 @@ namespace Flakes::NetBinary
 	{
 		FRecursiveMemoryWriter MemoryWriter(OutData, Object);
 		ConfigureNetArchive(MemoryWriter);
-		const_cast<UObject*>(Object)->Serialize(MemoryWriter);
+		MemoryWriter.SerializeExport(const_cast<UObject*>(Object));
 
 		if (MemoryWriter.IsError())
 		{
@@ -50,12 +51,13 @@ namespace Flakes::NetBinary
 		MemoryWriter.Close();
 	}
 
-	void FSerializationProvider_NetBinary::WriteData(const FStructView& Struct, const TArray<uint8>& Data, UObject* Outer)
+	void FSerializationProvider_NetBinary::WriteData(const FStructView& Struct, const TConstArrayView<uint8> Data, UObject* Outer)
 	{
 		FRecursiveMemoryReader MemoryReader(Data, false, Outer);
 		ConfigureNetArchive(MemoryReader);
 		// For some reason, SerializeItem is not const, so we have to const_cast the ScriptStruct
-		const_cast<UScriptStruct*>(Struct.GetScriptStruct())->SerializeItem(MemoryReader, Struct.GetMemory(), nullptr);
+		MemoryReader.SerializeWithBulkArrays(Struct.GetScriptStruct(), Struct.GetMemory(),
+			[&] { const_cast<UScriptStruct*>(Struct.GetScriptStruct())->SerializeItem(MemoryReader, Struct.GetMemory(), nullptr); });
 
 		if (MemoryReader.IsError())
 		{
@@ -66,11 +68,11 @@ namespace Flakes::NetBinary
 		MemoryReader.Close();
 	}
 
-	void FSerializationProvider_NetBinary::WriteData(UObject* Object, const TArray<uint8>& Data)
+	void FSerializationProvider_NetBinary::WriteData(UObject* Object, const TConstArrayView<uint8> Data)
 	{
 		FRecursiveMemoryReader MemoryReader(Data, false, Object);
 		ConfigureNetArchive(MemoryReader);
-		Object->Serialize(MemoryReader);
+		MemoryReader.SerializeExport(Object);
 
 		if (MemoryReader.IsError())
 		{
@@ -0,0 +1,146 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "Providers/FlakesPodSerializer.h"
+#include "FlakesLogging.h"
+#include "FlakesSerializationPlan.h"
+#include "Providers/FlakesFastBinarySerializer.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace Flakes::Pod
+{
+	namespace Private
+	{
+		enum class EMode : uint8
+		{
+			// The struct's memory, as is.
+			Pod,
+			// The struct's plan, run on a plain memory archive.
+			Flat,
+			// A FastBinary payload.
+			FastBinary
+		};
+
+		static_assert(static_cast<uint8>(EMode::FastBinary) == FastBinaryMode);
+
+		constexpr int32 PrefixSize = sizeof(EMode) + sizeof(uint32);
+
+		void WritePrefix(TArray<uint8>& OutData, const EMode Mode, const uint32 LayoutHash)
+		{
+			const int32 Start = OutData.AddUninitialized(PrefixSize);
+			OutData[Start] = static_cast<uint8>(Mode);
+			FMemory::Memcpy(OutData.GetData() + Start + sizeof(EMode), &LayoutHash, sizeof(uint32));
+		}
+
+		bool ValidateLayout(const TConstArrayView<uint8> Data, const Plan::FPlan& Plan, const UStruct* Struct)
+		{
+			uint32 LayoutHash;
+			FMemory::Memcpy(&LayoutHash, Data.GetData() + sizeof(EMode), sizeof(uint32));
+
+			if (LayoutHash != Plan.LayoutHash)
+			{
+				UE_LOG(LogFlakes, Error, TEXT("Pod payload was written with a different layout of '%s'"), *Struct->GetName())
+				return false;
+			}
+
+			return true;
+		}
+	}
+
+	void FSerializationProvider_Pod::ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer)
+	{
+		const TSharedRef<const Plan::FPlan> Plan = Plan::GetPlan(Struct.GetScriptStruct());
+
+		if (Plan->IsPod)
+		{
+			Private::WritePrefix(OutData, Private::EMode::Pod, Plan->LayoutHash);
+			OutData.Append(Struct.GetMemory(), Plan->Size);
+			return;
+		}
+
+		if (Plan->IsFlat)
+		{
+			Private::WritePrefix(OutData, Private::EMode::Flat, Plan->LayoutHash);
+
+			FMemoryWriter MemoryWriter(OutData);
+			MemoryWriter.Seek(OutData.Num());
+			Plan->Execute(MemoryWriter, const_cast<uint8*>(Struct.GetMemory()));
+
+			if (MemoryWriter.IsError())
+			{
+				UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_Pod::ReadData failed to serialized struct!"));
+			}
+			return;
+		}
+
+		OutData.Add(static_cast<uint8>(Private::EMode::FastBinary));
+		FastBinary::Type::ReadData(Struct, OutData, Outer);
+	}
+
+	void FSerializationProvider_Pod::ReadData(const UObject* Object, TArray<uint8>& OutData)
+	{
+		OutData.Add(static_cast<uint8>(Private::EMode::FastBinary));
+		FastBinary::Type::ReadData(Object, OutData);
+	}
+
+	void FSerializationProvider_Pod::WriteData(const FStructView& Struct, const TConstArrayView<uint8> Data, UObject* Outer)
+	{
+		if (Data.IsEmpty())
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_Pod::WriteData given an empty payload!"));
+			return;
+		}
+
+		const Private::EMode Mode = static_cast<Private::EMode>(Data[0]);
+		if (Mode == Private::EMode::FastBinary)
+		{
+			FastBinary::Type::WriteData(Struct, Data.RightChop(1), Outer);
+			return;
+		}
+
+		const TSharedRef<const Plan::FPlan> Plan = Plan::GetPlan(Struct.GetScriptStruct());
+		if (Data.Num() < Private::PrefixSize || !Private::ValidateLayout(Data, *Plan, Struct.GetScriptStruct()))
+		{
+			return;
+		}
+
+		const TConstArrayView<uint8> Payload = Data.RightChop(Private::PrefixSize);
+
+		switch (Mode)
+		{
+		case Private::EMode::Pod:
+			if (Payload.Num() != Plan->Size)
+			{
+				UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_Pod::WriteData expected %i bytes, but was given %i!"),
+					Plan->Size, Payload.Num());
+				return;
+			}
+			FMemory::Memcpy(Struct.GetMemory(), Payload.GetData(), Plan->Size);
+			break;
+		case Private::EMode::Flat:
+			{
+				FMemoryReaderView MemoryReader(Payload, true);
+				Plan->Execute(MemoryReader, Struct.GetMemory());
+
+				if (MemoryReader.IsError())
+				{
+					UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_Pod::WriteData failed to serialized struct!"));
+				}
+			}
+			break;
+		default:
+			UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_Pod::WriteData found unknown mode: %i"), Data[0]);
+		}
+	}
+
+	void FSerializationProvider_Pod::WriteData(UObject* Object, const TConstArrayView<uint8> Data)
+	{
+		if (Data.IsEmpty() || static_cast<Private::EMode>(Data[0]) != Private::EMode::FastBinary)
+		{
+			UE_LOG(LogFlakes, Error, TEXT("FSerializationProvider_Pod::WriteData given an invalid object payload!"));
+			return;
+		}
+
+		FastBinary::Type::WriteData(Object, Data.RightChop(1));
+	}
+}
\ No newline at end of file
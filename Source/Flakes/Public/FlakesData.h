@@ -2,8 +2,124 @@
 
 #pragma once
 
+#include "Misc/Guid.h"
+
 #include "FlakesData.generated.h"
 
+// Versioning for flakes serialized with operator<<.
+struct FLAKES_API FFlakesCustomVersion
+{
+	enum Type
+	{
+		BeforeCustomVersionWasAdded = 0,
+
+		// Flakes carry an FFlakeHeader describing their payload.
+		AddedFlakeHeader,
+
+		// FFlakeHeader records the dictionary used to encode the payload.
+		AddedHeaderDictionaryId,
+
+		// FFlakeHeader records the chunk table of payloads compressed in parallel.
+		AddedChunkedCompression,
+
+		// -----<new versions can be added above this line>-------------------------------------------------
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	// The GUID for this custom version number
+	const static FGuid GUID;
+
+private:
+	FFlakesCustomVersion() = delete;
+};
+
+// How the data in a flake is stored.
+UENUM()
+enum class EFlakeCodec : uint8
+{
+	// The flake predates headers, so its storage is unknown. FWriteOptions decide how to read it.
+	Unknown,
+
+	// Data is the raw provider payload.
+	None,
+
+	// Data is a single Oodle stream.
+	Oodle,
+
+	// Data is a sequence of independent Oodle streams, described by the chunk table in the header.
+	OodleChunked,
+};
+
+/*
+ * Describes the payload of a flake, so that it can be read back without the caller knowing how it was made.
+ */
+USTRUCT()
+struct FLAKES_API FFlakeHeader
+{
+	GENERATED_BODY()
+
+	// Format of the current header. Zero is reserved for flakes made before headers existed.
+	static constexpr uint8 CurrentVersion = 3;
+
+	UPROPERTY()
+	uint8 Version = 0;
+
+	UPROPERTY()
+	EFlakeCodec Codec = EFlakeCodec::Unknown;
+
+	// FOodleDataCompression::ECompressor used, when Codec is Oodle.
+	UPROPERTY()
+	uint8 Compressor = 0;
+
+	// FOodleDataCompression::ECompressionLevel used, when Codec is Oodle.
+	UPROPERTY()
+	int8 CompressionLevel = 0;
+
+	// Size of the payload after decompression.
+	UPROPERTY()
+	int64 UncompressedSize = 0;
+
+	// The provider that created the payload.
+	UPROPERTY()
+	FName Provider;
+
+	// Id of the FFlakesDictionary the payload was encoded with, or zero if none was used.
+	UPROPERTY()
+	uint32 DictionaryId = 0;
+
+	// Uncompressed size of each chunk, except for the last, which holds the remainder, when Codec is OodleChunked.
+	UPROPERTY()
+	int32 ChunkSize = 0;
+
+	// Compressed size of each chunk, when Codec is OodleChunked.
+	UPROPERTY()
+	TArray<int32> Chunks;
+
+	bool IsLegacy() const { return Version == 0; }
+
+	friend FArchive& operator<<(FArchive& Ar, FFlakeHeader& Header)
+	{
+		Ar.UsingCustomVersion(FFlakesCustomVersion::GUID);
+		Ar << Header.Version;
+		Ar << Header.Codec;
+		Ar << Header.Compressor;
+		Ar << Header.CompressionLevel;
+		Ar << Header.UncompressedSize;
+		Ar << Header.Provider;
+		if (Ar.CustomVer(FFlakesCustomVersion::GUID) >= FFlakesCustomVersion::AddedHeaderDictionaryId)
+		{
+			Ar << Header.DictionaryId;
+		}
+		if (Ar.CustomVer(FFlakesCustomVersion::GUID) >= FFlakesCustomVersion::AddedChunkedCompression)
+		{
+			Ar << Header.ChunkSize;
+			Ar << Header.Chunks;
+		}
+		return Ar;
+	}
+};
+
 USTRUCT(BlueprintType)
 struct FLAKES_API FFlake
 {
@@ -13,6 +129,9 @@ struct FLAKES_API FFlake
 	UPROPERTY()
 	FSoftObjectPath Struct;
 
+	UPROPERTY()
+	FFlakeHeader Header;
+
 	UPROPERTY()
 	TArray<uint8> Data;
 
@@ -23,7 +142,12 @@ struct FLAKES_API FFlake
 
 	friend FArchive& operator<<(FArchive& Ar, FFlake& Flake)
 	{
+		Ar.UsingCustomVersion(FFlakesCustomVersion::GUID);
 		Ar << Flake.Struct;
+		if (Ar.CustomVer(FFlakesCustomVersion::GUID) >= FFlakesCustomVersion::AddedFlakeHeader)
+		{
+			Ar << Flake.Header;
+		}
 		Ar << Flake.Data;
 #if WITH_EDITOR
 		Ar << Flake.DebugString;
@@ -47,7 +171,12 @@ struct FLAKES_API FFlake_Actor : public FFlake
 
 	friend FArchive& operator<<(FArchive& Ar, FFlake_Actor& Flake)
 	{
+		Ar.UsingCustomVersion(FFlakesCustomVersion::GUID);
 		Ar << Flake.Struct;
+		if (Ar.CustomVer(FFlakesCustomVersion::GUID) >= FFlakesCustomVersion::AddedFlakeHeader)
+		{
+			Ar << Flake.Header;
+		}
 		Ar << Flake.Data;
 		Ar << Flake.Transform;
 		return Ar;
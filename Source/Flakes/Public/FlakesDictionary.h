@@ -0,0 +1,57 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "FlakesData.h"
+
+#include "FlakesDictionary.generated.h"
+
+/*
+ * A reference payload trained from sample flakes of one type, or one named group of types. Small flakes of the same
+ * type share most of their bytes, but Oodle compresses each flake on its own and can't exploit that. Payloads are
+ * delta encoded against the dictionary before compression instead, turning the shared bytes into runs of zeros.
+ * Bytes are only compared at the same offset, so this suits fixed-layout payloads. A string, array, or other variable
+ * length field early in a payload shifts everything after it, and the rest of the dictionary then matches nothing.
+ * Such payloads still round trip, they just don't compress any better.
+ */
+USTRUCT(BlueprintType)
+struct FLAKES_API FFlakesDictionary
+{
+	GENERATED_BODY()
+
+	// Identifier stored in the header of flakes encoded with this dictionary. Zero is never a valid id.
+	UPROPERTY()
+	uint32 Id = 0;
+
+	// The struct, class, or group this dictionary was trained for.
+	UPROPERTY()
+	FName Name;
+
+	UPROPERTY()
+	TArray<uint8> Bytes;
+
+	bool IsValid() const { return Id != 0 && !Bytes.IsEmpty(); }
+
+	// Encodes or decodes a payload with this dictionary. The delta is symmetric, so this is its own inverse.
+	void Apply(TArrayView<uint8> Payload) const;
+
+	friend FArchive& operator<<(FArchive& Ar, FFlakesDictionary& Dictionary)
+	{
+		Ar << Dictionary.Id;
+		Ar << Dictionary.Name;
+		Ar << Dictionary.Bytes;
+		return Ar;
+	}
+};
+
+namespace Flakes::Dictionary
+{
+	// Trains a dictionary from raw provider payloads. The samples should all be made by the same provider.
+	FLAKES_API FFlakesDictionary Train(FName Name, TConstArrayView<TConstArrayView<uint8>> Samples);
+
+	// Trains a dictionary from existing flakes, which are decompressed first.
+	FLAKES_API FFlakesDictionary Train(FName Name, TConstArrayView<FFlake> Samples);
+
+	FLAKES_API bool SaveToFile(const FFlakesDictionary& Dictionary, const FString& Filename);
+	FLAKES_API bool LoadFromFile(const FString& Filename, FFlakesDictionary& OutDictionary);
+}
\ No newline at end of file
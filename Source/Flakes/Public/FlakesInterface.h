@@ -5,10 +5,16 @@
 #include "Compression/OodleDataCompression.h"
 #include "Concepts/BaseStructureProvider.h"
 #include "FlakesData.h"
+#include "FlakesDictionary.h"
 #include "GameFramework/Actor.h"
 #include "StructUtils/InstancedStruct.h"
 #include "StructUtils/StructView.h"
+#include "Tasks/Task.h"
 #include "UObject/Package.h"
+#include "UObject/StrongObjectPtr.h"
+
+struct FFlakesProviderHandle;
+struct FStreamableHandle;
 
 namespace Flakes
 {
@@ -16,15 +22,72 @@ namespace Flakes
 	{
 		FOodleDataCompression::ECompressor Compressor = FOodleDataCompression::ECompressor::Kraken;
 		FOodleDataCompression::ECompressionLevel CompressionLevel = FOodleDataCompression::ECompressionLevel::SuperFast;
+
+		// Lets CompressFlake decide per flake if compression is worth it, and store the data raw when it isn't.
+		uint8 AdaptiveCompression : 1 = false;
+
+		// Adaptive only: payloads smaller than this many bytes are never compressed.
+		int32 MinCompressionSize = 64;
+
+		// Adaptive only: compressed data is only kept if it's at most this fraction of the raw size.
+		float MinCompressionRatio = 0.9f;
+
+		// Adaptive only: if set, overrides Compressor and CompressionLevel with the strongest setting expected to
+		// compress at least this many bytes per millisecond.
+		float ThroughputBudget = 0.f;
+
+		// Payloads of at least this many bytes are split into chunks of ChunkSize, which are compressed, and later
+		// decompressed, in parallel. Zero disables chunking.
+		int32 ChunkedCompressionThreshold = 8 * 1024 * 1024;
+		int32 ChunkSize = 256 * 1024;
+
+		// Dictionary to delta encode the payload with before compression. Must also be registered with FFlakesModule,
+		// or passed to FWriteOptions, for the flake to be readable.
+		const FFlakesDictionary* Dictionary = nullptr;
+	};
+
+	/*
+	 * Supplies objects for CreateObject to reuse, instead of allocating new ones.
+	 */
+	struct IObjectPool
+	{
+		virtual ~IObjectPool() = default;
+
+		// Returns an unused object of exactly this class, or null to have a new one created. The object is moved into
+		// Outer, if it isn't already in it, and reset to its class defaults, before the flake is read into it.
+		virtual UObject* Acquire(const UClass* Class, UObject* Outer) = 0;
+
+		// Offered subobjects that were made stale by ReconcileSubobjects. Returns false to have them discarded instead.
+		virtual bool Release(UObject* Object) { return false; }
 	};
 
 	struct FWriteOptions
 	{
-		// Skips running the DecompressFlake step. Only safe to enable if you know the source is not compressed.
+		// Skips running the DecompressFlake step. Only consulted for legacy flakes without a header, as flakes with a
+		// header already know if they are compressed. Only safe to enable if you know the source is not compressed.
 		uint8 SkipDecompressionStep : 1 = false;
 
 		// Calls PostLoad on the outermost UObject after deserialization, or PostScriptConstruct when deserializing structs.
 		uint8 ExecPostLoadOrPostScriptConstruct : 1 = false;
+
+		// Lets the binary providers read subobjects back into the objects already in their slots, when the class and
+		// outer match, instead of creating new ones. Reused objects are reset to their class defaults first.
+		// Subobjects held in arrays, sets, and maps are never reused, as containers are emptied before they're read.
+		uint8 ReuseSubobjects : 1 = false;
+
+		// For reading into existing objects, as when repeatedly restoring state. Implies ReuseSubobjects, and releases
+		// any owned subobject that was replaced, and not reused elsewhere, to ObjectPool, or discards it.
+		// Slots that the flake doesn't write, such as those the tagged Binary provider skips for matching the class
+		// defaults, keep their current object. Subobjects in containers are released when they're no longer in any of
+		// the object's containers, but only containers directly in the object are checked, not those inside structs.
+		uint8 ReconcileSubobjects : 1 = false;
+
+		// Dictionary to decode the payload with. If null, or if its id doesn't match the flake, the dictionary is looked
+		// up from those registered with FFlakesModule.
+		const FFlakesDictionary* Dictionary = nullptr;
+
+		// Pool that CreateObject takes its root object from. Implies ReuseSubobjects, and must outlive the call.
+		IObjectPool* ObjectPool = nullptr;
 	};
 
 	// This is the default value for CreateX functions as they have PostLoad/Construct enabled by default for back-compat.
@@ -37,26 +100,118 @@ namespace Flakes
 		[[nodiscard]] FLAKES_API bool VerifyStruct(const FFlake& Flake, const UStruct* Expected, UStruct*& OutStruct);
 
 		[[nodiscard]] FLAKES_API bool CompressFlake(FFlake& Flake, TArray<uint8>&& Raw, const FReadOptions& Options);
-		[[nodiscard]] FLAKES_API bool DecompressFlake(const FFlake& Flake, TArray<uint8>& Raw, const FWriteOptions& Options);
+
+		// Variant for payloads the flake cannot take ownership of. Raw is only copied when it has to be stored as is.
+		[[nodiscard]] FLAKES_API bool CompressFlake(FFlake& Flake, TConstArrayView<uint8> Raw, const FReadOptions& Options);
+
+#if WITH_EDITOR
+		// Text payloads are decoded from UTF-8 for FFlake::DebugString, while anything else is shown a byte per character.
+		FLAKES_API FString MakeDebugString(TConstArrayView<uint8> Raw, bool Text);
+#endif
+
+		// Produces a view of the raw payload of a flake. This either points directly into the flake's data, or into Buffer,
+		// if decompression was required, so Buffer must outlive any use of OutRaw.
+		[[nodiscard]] FLAKES_API bool DecompressFlake(const FFlake& Flake, TArray<uint8>& Buffer, TConstArrayView<uint8>& OutRaw, const FWriteOptions& Options);
+
+		// Warns if a flake is about to be read by a different provider than the one that made it.
+		FLAKES_API void VerifyProvider(const FFlake& Flake, FName Provider);
+
+		/*
+		 * Records the objects created by FRecursiveMemoryReader on this thread for as long as it's in scope, so they can
+		 * be PostLoaded without searching the object hash for them. Scopes can be nested, and only the innermost records.
+		 */
+		class FLAKES_API FCreatedObjectsScope : FNoncopyable
+		{
+		public:
+			explicit FCreatedObjectsScope(bool ReuseSubobjects = false, bool ReconcileSubobjects = false);
+			explicit FCreatedObjectsScope(const FWriteOptions& Options)
+			  : FCreatedObjectsScope(Options.ReuseSubobjects || Options.ReconcileSubobjects || Options.ObjectPool,
+				  Options.ReconcileSubobjects) {}
+			~FCreatedObjectsScope();
+
+			static FCreatedObjectsScope* Get();
+
+			// Should readers reuse existing subobjects. Reused objects are reported as created as well.
+			bool ShouldReuseSubobjects() const { return ReuseSubobjects; }
+
+			// Should readers report owned subobjects that they replaced.
+			bool ShouldReconcileSubobjects() const { return ReconcileSubobjects; }
+			void AddReplaced(UObject* Object) { Replaced.Add(Object); }
+
+			// Releases every replaced subobject that wasn't also read into, to the pool, or as garbage.
+			void ReleaseStaleSubobjects(IObjectPool* Pool);
+
+			// Called by readers that report their objects, even if they end up creating none.
+			void MarkRecorded() { Recorded = true; }
+			void Add(UObject* Object) { Objects.Add(Object); }
+
+			// Every object created in this scope, in creation order, or null if no reader reported its objects.
+			const TArray<UObject*>* GetCreatedObjects() const { return Recorded ? &Objects : nullptr; }
+			TOptional<TArray<UObject*>> ConsumeCreatedObjects();
+
+		private:
+			FCreatedObjectsScope* Previous;
+			TArray<UObject*> Objects;
+			TArray<UObject*> Replaced;
+			bool Recorded = false;
+			bool ReuseSubobjects = false;
+			bool ReconcileSubobjects = false;
+		};
+
+		// Resets all properties to their class defaults, except for those holding instanced subobjects, or subobjects
+		// owned by the object, which are left for the reader to reuse, or replace. Containers are reset as a whole.
+		FLAKES_API void ResetToClassDefaults(UObject* Object);
+
+		// Takes an object from the options' pool, if it has one, and otherwise creates a new one.
+		FLAKES_API UObject* NewOrPooledObject(UObject* Outer, const UClass* Class, const FWriteOptions& Options);
 
 		FLAKES_API void PostLoadStruct(const FStructView& Struct);
-		FLAKES_API void PostLoadUObject(UObject* Object);
+
+		// PostLoads the object, and then each object created while reading it. If CreatedObjects is null, the object's
+		// subobjects are searched for instead.
+		FLAKES_API void PostLoadUObject(UObject* Object, const TArray<UObject*>* CreatedObjects);
+
+		// Can a struct of this type be serialized by a thread-safe provider on a worker thread. Structs that reference
+		// UObjects must stay on the game thread, as the objects can be resolved, created, or garbage collected.
+		[[nodiscard]] FLAKES_API bool CanSerializeOffGameThread(const UScriptStruct* Struct);
 	}
 
-	/* Interface for using Providers dynamically from their FName. */
+	/*
+	 * Interface for using Providers dynamically from their FName.
+	 * ReadData must append to OutData, and never assume it starts empty, so that multiple payloads can share a buffer.
+	 * WriteData only views the payload, so it can be fed directly from a flake, or any other memory, without copying.
+	 */
 	struct ISerializationProvider : FVirtualDestructor, FNoncopyable
 	{
 		virtual FName GetProviderName() = 0;
+
+		// Can ReadData and WriteData for structs be called from worker threads. Objects are always serialized on the game thread.
+		virtual bool IsThreadSafe() const { return false; }
+
+		// Are payloads UTF-8 text, rather than binary.
+		virtual bool IsText() const { return false; }
+
 		virtual void Virtual_ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer = nullptr) = 0;
 		virtual void Virtual_ReadData(const UObject* Object, TArray<uint8>& OutData) = 0;
-		virtual void Virtual_WriteData(const FStructView& Struct, const TArray<uint8>& Data, UObject* Outer = nullptr) = 0;
-		virtual void Virtual_WriteData(UObject* Object, const TArray<uint8>& Data) = 0;
+		virtual void Virtual_WriteData(const FStructView& Struct, TConstArrayView<uint8> Data, UObject* Outer = nullptr) = 0;
+		virtual void Virtual_WriteData(UObject* Object, TConstArrayView<uint8> Data) = 0;
 	};
 
 	// Template implementation of ISerializationProvider that forwards to the static versions.
-	template <typename Impl>
+	template <typename Impl, bool bThreadSafe = false, bool bText = false>
 	struct TSerializationProvider : ISerializationProvider
 	{
+		static constexpr bool ThreadSafe = bThreadSafe;
+		static constexpr bool Text = bText;
+
+		virtual bool IsThreadSafe() const override final
+		{
+			return bThreadSafe;
+		}
+		virtual bool IsText() const override final
+		{
+			return bText;
+		}
 		virtual void Virtual_ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer = nullptr) override final
 		{
 			Impl::ReadData(Struct, OutData, Outer);
@@ -65,11 +220,11 @@ namespace Flakes
 		{
 			Impl::ReadData(Object, OutData);
 		}
-		virtual void Virtual_WriteData(const FStructView& Struct, const TArray<uint8>& Data, UObject* Outer = nullptr) override final
+		virtual void Virtual_WriteData(const FStructView& Struct, TConstArrayView<uint8> Data, UObject* Outer = nullptr) override final
 		{
 			Impl::WriteData(Struct, Data, Outer);
 		}
-		virtual void Virtual_WriteData(UObject* Object, const TArray<uint8>& Data) override final
+		virtual void Virtual_WriteData(UObject* Object, TConstArrayView<uint8> Data) override final
 		{
 			Impl::WriteData(Object, Data);
 		}
@@ -80,7 +235,18 @@ namespace Flakes
 
 	// Macro to declare a new provider. The implementations of ReadData and WriteData must be defined to match these signatures.
 #define SERIALIZATION_PROVIDER_HEADER(API, Name, Pseudonym)\
-	struct API FSerializationProvider_##Name final : TSerializationProvider<FSerializationProvider_##Name>\
+	SERIALIZATION_PROVIDER_HEADER_IMPL(API, Name, Pseudonym, false, false)
+
+	// Variant of SERIALIZATION_PROVIDER_HEADER for providers whose struct serialization may run on worker threads.
+#define THREADSAFE_SERIALIZATION_PROVIDER_HEADER(API, Name, Pseudonym)\
+	SERIALIZATION_PROVIDER_HEADER_IMPL(API, Name, Pseudonym, true, false)
+
+	// Variant of SERIALIZATION_PROVIDER_HEADER for providers that write UTF-8 text.
+#define TEXT_SERIALIZATION_PROVIDER_HEADER(API, Name, Pseudonym)\
+	SERIALIZATION_PROVIDER_HEADER_IMPL(API, Name, Pseudonym, false, true)
+
+#define SERIALIZATION_PROVIDER_HEADER_IMPL(API, Name, Pseudonym, ThreadSafe, Text)\
+	struct API FSerializationProvider_##Name final : TSerializationProvider<FSerializationProvider_##Name, ThreadSafe, Text>\
 	{\
 		static inline const FLazyName ProviderName = FLazyName(TEXT(#Name));\
 		virtual FName GetProviderName() override\
@@ -89,8 +255,8 @@ namespace Flakes
 		}\
 		static void ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer = nullptr);\
 		static void ReadData(const UObject* Object, TArray<uint8>& OutData);\
-		static void WriteData(const FStructView& Struct, const TArray<uint8>& Data, UObject* Outer = nullptr);\
-		static void WriteData(UObject* Object, const TArray<uint8>& Data);\
+		static void WriteData(const FStructView& Struct, TConstArrayView<uint8> Data, UObject* Outer = nullptr);\
+		static void WriteData(UObject* Object, TConstArrayView<uint8> Data);\
 	};\
 	using Pseudonym = FSerializationProvider_##Name;
 
@@ -99,6 +265,12 @@ namespace Flakes
 	FLAKES_API FFlake MakeFlake(FName Serializer, const UObject* Object, FReadOptions Options = {});
 	FLAKES_API void WriteStruct(FName Serializer, const FStructView& Struct, const FFlake& Flake, UObject* Outer = nullptr, FWriteOptions Options = {});
 	FLAKES_API void WriteObject(FName Serializer, UObject* Object, const FFlake& Flake, FWriteOptions Options = {});
+	// Overloads for a cached provider handle, which avoid looking up the provider on every call.
+	FLAKES_API FFlake MakeFlake(const FFlakesProviderHandle& Serializer, const FConstStructView& Struct, const UObject* Outer = nullptr, const FReadOptions& Options = {});
+	FLAKES_API FFlake MakeFlake(const FFlakesProviderHandle& Serializer, const UObject* Object, const FReadOptions& Options = {});
+	FLAKES_API void WriteStruct(const FFlakesProviderHandle& Serializer, const FStructView& Struct, const FFlake& Flake, UObject* Outer = nullptr, const FWriteOptions& Options = {});
+	FLAKES_API void WriteObject(const FFlakesProviderHandle& Serializer, UObject* Object, const FFlake& Flake, const FWriteOptions& Options = {});
+
 	FLAKES_API FInstancedStruct CreateStruct(FName Serializer, const FFlake& Flake, const UScriptStruct* ExpectedStruct, FWriteOptions Options = CreationDefault, UObject* Outer = nullptr);
 	FLAKES_API UObject* CreateObject(FName Serializer, const FFlake& Flake, UObject* Outer, const UClass* ExpectedClass, FWriteOptions Options = CreationDefault);
 
@@ -110,6 +282,47 @@ namespace Flakes
 		return Cast<T>(CreateObject(Serializer, Flake, Outer, T::StaticClass(), Options));
 	}
 
+	/*
+	 * Batch flake API. The provider is resolved once for the whole batch, payloads are written into a shared scratch
+	 * buffer, and compression is spread across worker threads. Struct serialization is also run on worker threads when
+	 * the provider is thread-safe, and the structs don't reference any UObjects.
+	 */
+	FLAKES_API TArray<FFlake> MakeFlakes(FName Serializer, TConstArrayView<FConstStructView> Structs, const UObject* Outer = nullptr, const FReadOptions& Options = {});
+	FLAKES_API TArray<FFlake> MakeFlakes(FName Serializer, TConstArrayView<const UObject*> Objects, const FReadOptions& Options = {});
+	FLAKES_API TArray<FInstancedStruct> CreateStructs(FName Serializer, TConstArrayView<FFlake> Flakes, const UScriptStruct* ExpectedStruct, const FWriteOptions& Options = CreationDefault, UObject* Outer = nullptr);
+	FLAKES_API TArray<UObject*> CreateObjects(FName Serializer, TConstArrayView<FFlake> Flakes, UObject* Outer, const UClass* ExpectedClass, const FWriteOptions& Options = CreationDefault);
+
+	/*
+	 * Collects the classes and assets a flake refers to, so they can be loaded before it is read. Only binary payloads
+	 * with a name table list their references; for other payloads, only the flake's own type is reported.
+	 */
+	FLAKES_API void GatherDependencies(const FFlake& Flake, TArray<FSoftObjectPath>& OutPaths, const FWriteOptions& Options = {});
+
+	/*
+	 * Starts async loads for everything GatherDependencies finds that isn't already in memory. OnLoaded is called on the
+	 * game thread once they have all loaded, or right away, if nothing needed loading, in which case null is returned.
+	 * Creating the flake from OnLoaded will then not have to synchronously load anything.
+	 */
+	FLAKES_API TSharedPtr<FStreamableHandle> PreloadDependencies(const FFlake& Flake, TFunction<void()>&& OnLoaded, const FWriteOptions& Options = {});
+
+	/*
+	 * Async flake API. Must be called from the game thread. Only the steps that touch UObjects, such as NewObject,
+	 * provider calls that can't run off the game thread, and PostLoad/PostScriptConstruct, are scheduled back onto the
+	 * game thread. Compression, decompression, and serialization of structs without UObject references, when the
+	 * provider is thread-safe, are run as background tasks. Objects flaked with FastBinary or Pod only have their
+	 * property values copied on the game thread, and are encoded in the background as well, as their plans can run on
+	 * the copies. Other providers serialize objects on the game thread, as they go through UObject::Serialize, which
+	 * classes can override to write more than their properties.
+	 * Inputs are copied before these return, but a Dictionary set in the options must outlive the task.
+	 * Created objects aren't kept alive by their outer, so the task holds a strong reference to them until its result
+	 * is consumed.
+	 */
+	FLAKES_API UE::Tasks::TTask<FFlake> MakeFlakeAsync(FName Serializer, const FConstStructView& Struct, const UObject* Outer = nullptr, const FReadOptions& Options = {});
+	FLAKES_API UE::Tasks::TTask<FFlake> MakeFlakeAsync(FName Serializer, const UObject* Object, const FReadOptions& Options = {});
+	FLAKES_API UE::Tasks::TTask<FInstancedStruct> CreateStructAsync(FName Serializer, const FFlake& Flake, const UScriptStruct* ExpectedStruct, const FWriteOptions& Options = CreationDefault, UObject* Outer = nullptr);
+	FLAKES_API UE::Tasks::TTask<bool> WriteObjectAsync(FName Serializer, UObject* Object, const FFlake& Flake, const FWriteOptions& Options = {});
+	FLAKES_API UE::Tasks::TTask<TStrongObjectPtr<UObject>> CreateObjectAsync(FName Serializer, const FFlake& Flake, UObject* Outer, const UClass* ExpectedClass, const FWriteOptions& Options = CreationDefault);
+
 	// Low-level templated flake API
 	template <CSerializationProvider T>
 	FFlake MakeFlake(const FConstStructView& Struct, const UObject* Outer, const FReadOptions Options = {})
@@ -118,12 +331,13 @@ namespace Flakes
 
 		FFlake Flake;
 		Flake.Struct = Struct.GetScriptStruct();
+		Flake.Header.Provider = T::ProviderName;
 
 		TArray<uint8> Raw;
 		T::ReadData(Struct, Raw, Outer);
 
 #if WITH_EDITOR
-		Flake.DebugString = BytesToString(Raw.GetData(), Raw.Num());
+		Flake.DebugString = Private::MakeDebugString(Raw, T::Text);
 #endif
 
 		(void)Private::CompressFlake(Flake, MoveTemp(Raw), Options);
@@ -138,12 +352,13 @@ namespace Flakes
 
 		FFlake Flake;
 		Flake.Struct = Object->GetClass();
+		Flake.Header.Provider = T::ProviderName;
 
 		TArray<uint8> Raw;
 		T::ReadData(Object, Raw);
 
 #if WITH_EDITOR
-		Flake.DebugString = BytesToString(Raw.GetData(), Raw.Num());
+		Flake.DebugString = Private::MakeDebugString(Raw, T::Text);
 #endif
 
 		(void)Private::CompressFlake(Flake, MoveTemp(Raw), Options);
@@ -160,8 +375,11 @@ namespace Flakes
 	template <CSerializationProvider T>
 	void WriteStruct(const FStructView& Struct, const FFlake& Flake, UObject* Outer, const FWriteOptions Options = {})
 	{
-		TArray<uint8> Raw;
-		if (!Private::DecompressFlake(Flake, Raw, Options))
+		Private::VerifyProvider(Flake, T::ProviderName);
+
+		TArray<uint8> Buffer;
+		TConstArrayView<uint8> Raw;
+		if (!Private::DecompressFlake(Flake, Buffer, Raw, Options))
 		{
 			return;
 		}
@@ -183,17 +401,22 @@ namespace Flakes
 	template <CSerializationProvider T>
 	void WriteObject(UObject* Object, const FFlake& Flake, const FWriteOptions Options = {})
 	{
-		TArray<uint8> Raw;
-		if (!Private::DecompressFlake(Flake, Raw, Options))
+		Private::VerifyProvider(Flake, T::ProviderName);
+
+		TArray<uint8> Buffer;
+		TConstArrayView<uint8> Raw;
+		if (!Private::DecompressFlake(Flake, Buffer, Raw, Options))
 		{
 			return;
 		}
 
+		Private::FCreatedObjectsScope CreatedObjects(Options);
 		T::WriteData(Object, Raw);
+		CreatedObjects.ReleaseStaleSubobjects(Options.ObjectPool);
 
 		if (Options.ExecPostLoadOrPostScriptConstruct)
 		{
-			Private::PostLoadUObject(Object);
+			Private::PostLoadUObject(Object, CreatedObjects.GetCreatedObjects());
 		}
 	}
 
@@ -249,7 +472,7 @@ namespace Flakes
 			return nullptr;
 		}
 
-		UObject* LoadedObject = NewObject<UObject>(Outer, ObjClass);
+		UObject* LoadedObject = Private::NewOrPooledObject(Outer, ObjClass, Options);
 		WriteObject<T>(LoadedObject, Flake, Options);
 
 		return LoadedObject;
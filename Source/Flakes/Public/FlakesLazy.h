@@ -0,0 +1,53 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "FlakesInterface.h"
+
+namespace Flakes
+{
+	/*
+	 * A flake that isn't made until its data is needed, for flakes that are made just in case, and rarely read.
+	 * Structs are copied when the lazy flake is made, while objects are only referenced, so an object flake captures the
+	 * state of the object when it's resolved. Pass a change counter to detect objects modified before then.
+	 * Converts to a regular FFlake, which resolves it. Copies share the same snapshot, and resolved flake.
+	 */
+	class FLAKES_API FLazyFlake
+	{
+	public:
+		FLazyFlake() = default;
+
+		// Wraps an already made flake.
+		FLazyFlake(const FFlake& Flake);
+
+		// Copies the struct, to be serialized when the flake is resolved. Outer is only weakly referenced.
+		// Structs that reference objects are made right away, as the copy wouldn't keep the objects alive. Unless the
+		// provider is thread-safe, the flake must be resolved on the game thread.
+		FLazyFlake(FName Serializer, const FConstStructView& Struct, const UObject* Outer = nullptr, const FReadOptions& Options = {});
+
+		// References the object, to be serialized when the flake is resolved, which must happen on the game thread.
+		// ChangeCounter should return a value that changes whenever the object is modified. A stale flake resolves to an
+		// empty flake, so callers must check IsStale before relying on it.
+		FLazyFlake(FName Serializer, const UObject* Object, TFunction<uint32()>&& ChangeCounter = {}, const FReadOptions& Options = {});
+
+		// Was this made with anything to resolve.
+		bool IsSet() const { return State.IsValid(); }
+
+		bool IsResolved() const;
+
+		// Has the object changed since this was made, so resolving it would no longer capture the original state.
+		bool IsStale() const;
+
+		// Makes the flake, if it hasn't been made yet. Empty if the object was destroyed, or is stale.
+		const FFlake& Get() const;
+
+		operator const FFlake&() const { return Get(); }
+
+		// Saving resolves the flake, and loading reads back a resolved one.
+		friend FLAKES_API FArchive& operator<<(FArchive& Ar, FLazyFlake& Flake);
+
+	private:
+		struct FState;
+		TSharedPtr<FState, ESPMode::ThreadSafe> State;
+	};
+}
\ No newline at end of file
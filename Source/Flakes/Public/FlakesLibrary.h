@@ -3,6 +3,7 @@
 #pragma once
 
 #include "FlakesInterface.h"
+#include "Engine/LatentActionManager.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "FlakesLibrary.generated.h"
 
@@ -55,6 +56,31 @@ public:
 	static AActor* ConstructActorFromFlake(const FFlake_Actor& Flake, UObject* WorldContextObj, const TSubclassOf<AActor> ExpectedClass,
 		UPARAM(meta=(GetOptions="Flakes.FlakesLibrary.GetAllProviders")) FName Serializer = FName("Binary"));
 
+	/** Serialize a struct into a flake, compressing it in the background. */
+	UFUNCTION(BlueprintCallable, Category = "Flakes|FlakeLibrary", meta = (Latent, LatentInfo = "LatentInfo", WorldContext = "WorldContextObj", DisplayName = "Make Flake Async (Struct)"))
+	static void MakeFlakeAsync_Struct(UObject* WorldContextObj, FLatentActionInfo LatentInfo, const FInstancedStruct& Struct, FFlake& Flake,
+		UPARAM(meta=(GetOptions="Flakes.FlakesLibrary.GetAllProviders")) FName Serializer = FName("Binary"));
+
+	/** Serialize an object (and all its subobjects) into a flake, compressing it in the background. */
+	UFUNCTION(BlueprintCallable, Category = "Flakes|FlakeLibrary", meta = (Latent, LatentInfo = "LatentInfo", WorldContext = "WorldContextObj", DisplayName = "Make Flake Async (Object)"))
+	static void MakeFlakeAsync(UObject* WorldContextObj, FLatentActionInfo LatentInfo, const UObject* Object, FFlake& Flake,
+		UPARAM(meta=(GetOptions="Flakes.FlakesLibrary.GetAllProviders")) FName Serializer = FName("Binary"));
+
+	/** Attempt to read a flake back into a struct, decompressing it in the background. */
+	UFUNCTION(BlueprintCallable, Category = "Flakes|FlakeLibrary", meta = (Latent, LatentInfo = "LatentInfo", WorldContext = "WorldContextObj"))
+	static void ConstructStructFromFlakeAsync(UObject* WorldContextObj, FLatentActionInfo LatentInfo, const FFlake& Flake,
+		const UScriptStruct* ExpectedStruct, FInstancedStruct& Struct,
+		UPARAM(meta=(GetOptions="Flakes.FlakesLibrary.GetAllProviders")) FName Serializer = FName("Binary"));
+
+	/**
+	 * Attempt to read a flake back into an object, decompressing it in the background.
+	 * Does not support actors!
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Flakes|FlakeLibrary", meta = (Latent, LatentInfo = "LatentInfo", WorldContext = "WorldContextObj", DeterminesOutputType = "ExpectedClass", DynamicOutputParam = "Object"))
+	static void ConstructObjectFromFlakeAsync(UObject* WorldContextObj, FLatentActionInfo LatentInfo, const FFlake& Flake,
+		UObject* Outer, const UClass* ExpectedClass, UObject*& Object,
+		UPARAM(meta=(GetOptions="Flakes.FlakesLibrary.GetAllProviders")) FName Serializer = FName("Binary"));
+
 	/** Get the size of the data payload in a flake */
 	UFUNCTION(BlueprintPure, Category = "Flakes|FlakeLibrary")
 	static int64 GetNumBytes(const FFlake& Flake);
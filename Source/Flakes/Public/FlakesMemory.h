@@ -4,44 +4,146 @@
 
 #include "Serialization/MemoryReader.h"
 #include "Serialization/MemoryWriter.h"
+#include "Templates/Function.h"
+#include "UObject/SoftObjectPath.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class FArrayProperty;
 
 namespace Flakes
 {
+	namespace Private
+	{
+		class FCreatedObjectsScope;
+	}
+
+	/*
+	 * Payloads written by FRecursiveMemoryWriter start with a small header, followed by the serialized data, and then
+	 * optionally a table of every name and soft path in the data, which the data refers to by index. The table is left
+	 * out when the data has no names or paths in it.
+	 * Payloads from before the header was added are still readable, as the header starts with a length no FString can
+	 * have, which a tagged archive would have started with.
+	 */
+	struct FRecursivePayloadHeader
+	{
+		enum class EVersion : uint8
+		{
+			AddedPayloadHeader = 1,
+			// Top-level arrays of numbers are written in one block after each struct or object
+			BulkArrays,
+
+			// -----<new versions can be added above this line>-------------------------------------------------
+			VersionPlusOne,
+			LatestVersion = VersionPlusOne - 1
+		};
+
+		enum class EFlags : uint8
+		{
+			None = 0,
+
+			// Names and soft paths are written as indices into the table at the end of the payload
+			NameTable = 1 << 0,
+		};
+
+		static constexpr uint32 Magic[2] = { 0x80000000, 0x534B4C46 }; // MIN_int32, 'FLKS'
+		static constexpr int32 Size = sizeof(Magic) + sizeof(uint8) * 2 + sizeof(uint32);
+
+		EVersion Version = EVersion::LatestVersion;
+		EFlags Flags = EFlags::None;
+
+		// Offset of the name table from the start of the payload, or zero if there isn't one.
+		uint32 TableOffset = 0;
+	};
+
+	ENUM_CLASS_FLAGS(FRecursivePayloadHeader::EFlags)
+
 	class FLAKES_API FRecursiveMemoryWriter : public FMemoryWriter
 	{
 	public:
-		FRecursiveMemoryWriter(TArray<uint8>& OutBytes, const UObject* Outer)
-		  : FMemoryWriter(OutBytes),
-			OuterStack({Outer}) {}
+		// Bytes are appended to the end of OutBytes, so that existing contents are preserved.
+		FRecursiveMemoryWriter(TArray<uint8>& OutBytes, const UObject* Outer);
 
 		using FMemoryWriter::operator<<; // For visibility of the overloads we don't override
 
 		//~ Begin FArchive Interface
+		virtual bool Close() override;
+		virtual FArchive& operator<<(FName& Value) override;
 		virtual FArchive& operator<<(UObject*& Obj) override;
 		virtual FArchive& operator<<(FObjectPtr& Obj) override;
 		virtual FArchive& operator<<(FSoftObjectPtr& AssetPtr) override;
 		virtual FArchive& operator<<(FSoftObjectPath& Value) override;
 		virtual FArchive& operator<<(FWeakObjectPtr& Value) override;
 		virtual FString GetArchiveName() const override;
+		virtual bool ShouldSkipProperty(const FProperty* InProperty) const override;
 		//~ End FArchive Interface
 
+		// Serializes the data of the root object, or an object exported into this payload.
+		virtual void SerializeExport(UObject* Obj);
+
+		// Serializes a struct or object with SerializeFunc, except for its top-level arrays of numbers, which are written
+		// after it, one block per array. Data is only read from.
+		void SerializeWithBulkArrays(const UStruct* Struct, void* Data, TFunctionRef<void()> SerializeFunc);
+
+	protected:
+		// Should the object be written into this payload, rather than referenced by path. By default, this is true for
+		// objects owned by an object already being exported, or by a world.
+		virtual bool ShouldExport(const UObject* Obj);
+
+		// The path of an object that isn't exported.
+		virtual FSoftObjectPath GetReferencePath(const UObject* Obj);
+
+		// Is the object currently being exported.
+		bool IsExporting(const UObject* Obj) const { return OuterStack.Contains(Obj); }
+
 	private:
+		// Is the object owned by a world, memoized per outer, as whole levels of objects tend to share a few outers.
+		bool IsOwnedByWorld(const UObject* Obj);
+
+		uint32 InternName(FName Name);
+		uint32 InternPath(const FSoftObjectPath& Path);
+		void WriteTable();
+
+		int64 PayloadStart = 0;
+		FRecursivePayloadHeader Header;
+		// Set once Close starts writing the table, after which names and paths are written in full.
+		bool TableWritten = false;
+
+		// Arrays of the struct or object currently being serialized, which are written in bulk after it instead.
+		TConstArrayView<const FArrayProperty*> BulkArrays;
+
+		TMap<FName, uint32> NameIndices;
+		TArray<FName> Names;
+		TMap<FSoftObjectPath, uint32> PathIndices;
+		TArray<FSoftObjectPath> Paths;
+
 		// Tracks what objects are currently being serialized. This allows us to only serialize UObjects that are directly
-		// owned *and* stored in the first outer.
-		TArray<const UObject*> OuterStack;
-		TArray<UObject*> ExportedObjects;
+		// owned *and* stored in the first outer. Only membership matters, since each object is exported at most once.
+		TSet<const UObject*> OuterStack;
+
+		// Maps each exported object to its index in export order, so later references can point back to it.
+		TMap<const UObject*, uint32> ExportedObjects;
+		TMap<const UObject*, bool> WorldOuters;
 	};
 
-	class FLAKES_API FRecursiveMemoryReader : public FMemoryReader
+	class FLAKES_API FRecursiveMemoryReader : public FMemoryReaderView
 	{
 	public:
-		FRecursiveMemoryReader(const TArray<uint8>& InBytes, bool bIsPersistent, UObject* Outer)
-		  : FMemoryReader(InBytes, bIsPersistent),
-			OuterStack({Outer}) {}
+		FRecursiveMemoryReader(TConstArrayView<uint8> InBytes, bool bIsPersistent, UObject* Outer);
+
+		using FMemoryReaderView::operator<<; // For visibility of the overloads we don't override
+
+		// The header of the payload. Legacy payloads without one report a zeroed version.
+		const FRecursivePayloadHeader& GetPayloadHeader() const { return Header; }
+
+		// Every object this reader has created, in creation order.
+		TConstArrayView<UObject*> GetCreatedObjects() const { return ImportedObjects; }
 
-		using FMemoryReader::operator<<; // For visibility of the overloads we don't override
+		// Reads only the name table of a payload, and appends every soft path in it, which includes the classes of all
+		// exported objects. Returns false if the payload has no table.
+		static bool GatherPaths(TConstArrayView<uint8> InBytes, TArray<FSoftObjectPath>& OutPaths);
 
 		//~ Begin FArchive Interface
+		virtual FArchive& operator<<(FName& Value) override;
 		virtual FArchive& operator<<(UObject*& Obj) override;
 		virtual FArchive& operator<<(FObjectPtr& Obj) override;
 		virtual FArchive& operator<<(FSoftObjectPtr& AssetPtr) override;
@@ -50,9 +152,39 @@ namespace Flakes
 		virtual FString GetArchiveName() const override;
 		//~ End FArchive Interface
 
+		// Deserializes the data of the root object, or an object created, or reused, by this reader.
+		virtual void SerializeExport(UObject* Obj);
+
+		// Deserializes a struct or object with SerializeFunc, followed by the blocks of any arrays written in bulk.
+		void SerializeWithBulkArrays(const UStruct* Struct, void* Data, TFunctionRef<void()> SerializeFunc);
+
 	private:
+		// Readers only register with a created objects scope when they are going to read the payload's data.
+		FRecursiveMemoryReader(TConstArrayView<uint8> InBytes, bool bIsPersistent, UObject* Outer, Private::FCreatedObjectsScope* Scope);
+
+		void ReadHeaderAndTable();
+
+		// Loads an object or class, caching the result for the rest of the archive.
+		UObject* ResolvePath(const FSoftObjectPath& Path);
+
+		FRecursivePayloadHeader Header;
+		TArray<FName> Names;
+		TArray<FSoftObjectPath> Paths;
+
 		// Tracks what objects are currently being deserialized. This allows us to reconstruct objects with their original
 		// outer.
 		TArray<UObject*> OuterStack;
+
+		// Every object created so far, in the order they were exported, to resolve back-references. This is also the
+		// order they are reported in to the FCreatedObjectsScope, if there is one.
+		TArray<UObject*> ImportedObjects;
+		Private::FCreatedObjectsScope* CreatedObjectsScope;
+
+		// Existing subobjects that have been read back into, when reusing them.
+		bool ReuseSubobjects = false;
+		TSet<UObject*> ReusedObjects;
+
+		// Weak, as loading one path may collect an object resolved for another. Failed loads are cached as explicit nulls.
+		TMap<FSoftObjectPath, TWeakObjectPtr<UObject>> ResolvedPaths;
 	};
 }
\ No newline at end of file
@@ -3,16 +3,46 @@
 #pragma once
 
 #include "Containers/Map.h"
+#include "FlakesDictionary.h"
+#include "HAL/CriticalSection.h"
 #include "Modules/ModuleInterface.h"
 #include "Templates/Function.h"
+#include "Templates/SharedPointer.h"
 #include "Templates/UniquePtr.h"
 #include "UObject/NameTypes.h"
 
+#include <atomic>
+
 namespace Flakes
 {
 	struct ISerializationProvider;
 }
 
+struct FStreamableManager;
+
+using FFlakesProviderPtr = TSharedPtr<Flakes::ISerializationProvider, ESPMode::ThreadSafe>;
+using FFlakesDictionaryPtr = TSharedPtr<const FFlakesDictionary, ESPMode::ThreadSafe>;
+
+/*
+ * A cached reference to a serialization provider, so repeated calls can skip looking it up by name.
+ * Handles are safe to use while the provider is removed: Pin returns null once it's gone, or the new provider, if one
+ * has been registered under the same name since.
+ */
+struct FLAKES_API FFlakesProviderHandle
+{
+	FFlakesProviderHandle() = default;
+	explicit FFlakesProviderHandle(FName ProviderName);
+
+	FName GetName() const { return Name; }
+
+	// Keeps the provider alive for as long as the returned pointer is held. Don't hold on to it beyond a single use.
+	FFlakesProviderPtr Pin() const;
+
+private:
+	FName Name;
+	TWeakPtr<Flakes::ISerializationProvider, ESPMode::ThreadSafe> Provider;
+};
+
 class FFlakesModule : public IModuleInterface
 {
 public:
@@ -30,8 +60,44 @@ public:
 	FLAKES_API void RemoveSerializationProvider(FName ProviderName);
 
 	using FSerializationProviderExec = TFunctionRef<void(Flakes::ISerializationProvider*)>;
-	bool UseSerializationProvider(FName ProviderName, const FSerializationProviderExec& Exec) const;
+	FLAKES_API bool UseSerializationProvider(FName ProviderName, const FSerializationProviderExec& Exec) const;
+
+	// Lock-free lookup, safe to call from any thread.
+	FLAKES_API FFlakesProviderPtr FindSerializationProvider(FName ProviderName) const;
+
+	/**     FLAKE DICTIONARY API    **/
+
+	// Registers a dictionary, so flakes encoded with it can be read without passing it to FWriteOptions.
+	FLAKES_API void AddDictionary(const FFlakesDictionary& Dictionary);
+	FLAKES_API void RemoveDictionary(uint32 DictionaryId);
+
+	// Safe to call from any thread. The dictionary stays valid for as long as the returned pointer is held, even if it's
+	// removed in the meantime.
+	FLAKES_API FFlakesDictionaryPtr FindDictionary(uint32 DictionaryId) const;
+
+	// Used to preload flake dependencies.
+	FLAKES_API FStreamableManager& GetStreamableManager();
 
 private:
-	TMap<FName, TUniquePtr<Flakes::ISerializationProvider>> SerializationProviders;
+	// Must be called while holding ProviderLock.
+	void PublishProviderTable();
+
+	struct FProviderTable
+	{
+		TMap<FName, TWeakPtr<Flakes::ISerializationProvider, ESPMode::ThreadSafe>> Providers;
+	};
+
+	// The current table, which readers use without locking. Tables are never modified once published, and are only
+	// freed on shutdown, as a reader on another thread may still be using a replaced one.
+	std::atomic<const FProviderTable*> ProviderTable = nullptr;
+	TArray<TUniquePtr<FProviderTable>> ProviderTables;
+
+	// Owns the registered providers. Only accessed while holding ProviderLock.
+	TMap<FName, TSharedRef<Flakes::ISerializationProvider, ESPMode::ThreadSafe>> SerializationProviders;
+	FCriticalSection ProviderLock;
+
+	TMap<uint32, TSharedRef<const FFlakesDictionary, ESPMode::ThreadSafe>> Dictionaries;
+	mutable FRWLock DictionaryLock;
+
+	TUniquePtr<FStreamableManager> StreamableManager;
 };
\ No newline at end of file
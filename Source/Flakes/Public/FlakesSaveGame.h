@@ -3,6 +3,7 @@
 #pragma once
 
 #include "FlakesData.h"
+#include "FlakesLazy.h"
 #include "GameFramework/SaveGame.h"
 #include "UObject/Package.h"
 
@@ -25,6 +26,9 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Flakes|FlakeSave")
 	void SetStructToSave(const FInstancedStruct& Data);
 
+	// Saves a flake that is only made when the save game is written, or loaded from.
+	void SetLazyFlakeToSave(const Flakes::FLazyFlake& InFlake);
+
 	UFUNCTION(BlueprintCallable, Category = "Flakes|FlakeSave")
 	UObject* LoadObjectFromData(UObject* Outer) const;
 
@@ -43,8 +47,12 @@ public:
 	UObject* LoadObjectFromDataClassChecked(UObject* Outer, const UClass* ExpectedClass) const;
 
 private:
+	const FFlake& GetFlake() const;
+
 	UPROPERTY()
 	FFlake Flake;
 
+	Flakes::FLazyFlake LazyFlake;
+
 	virtual void Serialize(FArchive& Ar) override;
 };
\ No newline at end of file
@@ -0,0 +1,77 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "UObject/Class.h"
+
+namespace Flakes::Plan
+{
+	enum class EOp : uint8
+	{
+		// A contiguous span of plain-old-data, copied as raw bytes.
+		Memcpy,
+		Bool,
+		String,
+		Name,
+		Object,
+		SoftObject,
+		WeakObject,
+		Array,
+		// A struct with its own Serialize, which is called directly.
+		NativeStruct,
+		// Anything else, serialized by its property.
+		Generic
+	};
+
+	struct FPlan;
+
+	struct FOp
+	{
+		EOp Op = EOp::Generic;
+
+		// Offset of the value from the start of the container the plan is executed on.
+		int32 Offset = 0;
+
+		// Number of bytes in a Memcpy span.
+		int32 Size = 0;
+
+		const FProperty* Property = nullptr;
+
+		// The struct of a NativeStruct.
+		UScriptStruct* Struct = nullptr;
+
+		// The plan for a single element of an Array.
+		TSharedPtr<const FPlan> Element;
+	};
+
+	/*
+	 * A flat list of operations that serializes every saved property of a struct or class, in place of walking its
+	 * properties with SerializeItem. Nested structs without their own Serialize are inlined into their parent's plan.
+	 */
+	struct FLAKES_API FPlan
+	{
+		TArray<FOp> Ops;
+
+		// Hash of the names, types, and offsets of every property in the plan. Payloads store this, so that a change
+		// in layout is detected, rather than read as garbage.
+		uint32 LayoutHash = 0;
+
+		// Is the entire plan a single memcpy of Size bytes.
+		bool IsPod = false;
+
+		// Does the plan only read and write bytes and strings, so that it doesn't need an archive that can handle names
+		// or object references.
+		bool IsFlat = false;
+		int32 Size = 0;
+
+		// Reads or writes the container, depending on the direction of the archive.
+		void Execute(FArchive& Ar, void* Container) const;
+	};
+
+	// Returns the plan for a struct or class, compiling and caching it on first use. Safe to call from any thread.
+	FLAKES_API TSharedRef<const FPlan> GetPlan(const UStruct* Struct);
+
+	// Can this property be copied as raw bytes. Native structs only can if they are plain-old-data, as they may have
+	// members that aren't properties, so any other struct is inlined a property at a time.
+	FLAKES_API bool IsPodProperty(const FProperty* Property);
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "Misc/ScopeRWLock.h"
+#include "UObject/Class.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+namespace Flakes
+{
+	namespace Private
+	{
+		// What a cached type is checked against, to tell if it has changed since its value was built.
+		struct FTypeVersion
+		{
+			const void* Link = nullptr;
+			int32 Size = 0;
+
+			bool operator==(const FTypeVersion& Other) const = default;
+		};
+
+		inline FTypeVersion GetTypeVersion(const UStruct* Struct)
+		{
+			return { Struct->PropertyLink, Struct->GetPropertiesSize() };
+		}
+
+		inline FTypeVersion GetTypeVersion(const UEnum* Enum)
+		{
+			return { nullptr, Enum->NumEnums() };
+		}
+	}
+
+	/*
+	 * A cache of values worked out once per UStruct or UEnum, which is safe to use from any thread. Types are keyed by
+	 * address, so each entry also remembers the type, and its version, to catch it being destroyed, or relinked in the
+	 * editor, in which case the value is built again.
+	 */
+	template <typename TType, typename TValue>
+	class TTypeCache
+	{
+	public:
+		template <typename TBuilder>
+		TSharedRef<const TValue> FindOrBuild(const TType* Type, TBuilder&& Build)
+		{
+			check(Type);
+
+			{
+				FReadScopeLock ReadLock(Lock);
+				if (const FEntry* Entry = Entries.Find(Type);
+					Entry && Entry->IsCurrent(Type))
+				{
+					return Entry->Value;
+				}
+			}
+
+			// Building outside the lock means two threads may both build the same value, which is harmless.
+			TSharedRef<const TValue> Value = Build(Type);
+
+			FWriteScopeLock WriteLock(Lock);
+			Entries.Add(Type, { Value, Type, Private::GetTypeVersion(Type) });
+			return Value;
+		}
+
+	private:
+		struct FEntry
+		{
+			TSharedRef<const TValue> Value;
+			TWeakObjectPtr<const TType> Type;
+			Private::FTypeVersion Version;
+
+			bool IsCurrent(const TType* InType) const
+			{
+				return Type.Get() == InType && Version == Private::GetTypeVersion(InType);
+			}
+		};
+
+		FRWLock Lock;
+		TMap<const TType*, FEntry> Entries;
+	};
+}
\ No newline at end of file
@@ -9,5 +9,5 @@ namespace Flakes::Binary
 	/*
 	 * A generic serialization provider intended for serializing data to a binary blob before writing to disk.
 	 */
-	SERIALIZATION_PROVIDER_HEADER(FLAKES_API, Binary, Type)
+	THREADSAFE_SERIALIZATION_PROVIDER_HEADER(FLAKES_API, Binary, Type)
 }
\ No newline at end of file
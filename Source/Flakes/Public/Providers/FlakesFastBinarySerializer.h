@@ -0,0 +1,19 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "FlakesInterface.h"
+
+namespace Flakes::FastBinary
+{
+	/*
+	 * A binary serialization provider that executes a compiled plan for each type, instead of walking its properties
+	 * every time. This is much faster for repeatedly serializing the same types, but only property data is saved, and
+	 * payloads are only readable while the layout of the type is unchanged.
+	 */
+	THREADSAFE_SERIALIZATION_PROVIDER_HEADER(FLAKES_API, FastBinary, Type)
+
+	// Runs the plan for a struct or class, preceded by its layout hash, which is validated when reading. Data may be
+	// the object itself, or any copy of its properties.
+	FLAKES_API void SerializeWithPlan(FArchive& Ar, const UStruct* Struct, void* Data);
+}
\ No newline at end of file
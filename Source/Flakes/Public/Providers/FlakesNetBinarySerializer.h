@@ -10,5 +10,5 @@ namespace Flakes::NetBinary
 	 * A binary serialization provider optimized for sending data over the network. This provider assumes that the data
 	 * is never written to disk. It requires about ~50% of the memory the regular binary provider uses.
 	 */
-	SERIALIZATION_PROVIDER_HEADER(FLAKES_API, NetBinary, Type)
+	THREADSAFE_SERIALIZATION_PROVIDER_HEADER(FLAKES_API, NetBinary, Type)
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "FlakesInterface.h"
+
+namespace Flakes::Pod
+{
+	/*
+	 * A serialization provider for snapshotting plain-old-data structs, such as FVector or FColor, as cheaply as
+	 * possible. POD structs are captured with a single memcpy, and structs of only POD, strings, and arrays of them are
+	 * written without any of the name or object handling of the other binary providers. Both store a layout hash, and
+	 * fail to read if it has changed. Everything else, including all objects, falls back to FastBinary.
+	 * Small snapshots are best made with adaptive compression, or a compression level of None, to skip Oodle as well.
+	 */
+	THREADSAFE_SERIALIZATION_PROVIDER_HEADER(FLAKES_API, Pod, Type)
+
+	// The first byte of payloads that fall back to FastBinary, which is followed by the FastBinary payload.
+	constexpr uint8 FastBinaryMode = 2;
+}
\ No newline at end of file
@@ -20,6 +20,7 @@ public class FlakesJson : ModuleRules
         PrivateDependencyModuleNames.AddRange(
             new []
             {
+                "Cbor",
                 "CoreUObject",
                 "Engine"
             }
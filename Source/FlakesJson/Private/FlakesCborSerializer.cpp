@@ -0,0 +1,565 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesCborSerializer.h"
+#include "FlakesJsonSerializer.h"
+#include "FlakesJsonStream.h"
+
+#include "CborReader.h"
+#include "CborWriter.h"
+#include "Math/Float16.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace Flakes::Cbor
+{
+	namespace Private
+	{
+		// Cbor data is always big-endian, so it can be read by tools on any platform.
+		constexpr ECborEndianness Endianness = ECborEndianness::StandardCompliant;
+
+		// The header of a half-precision float, major type 7 with an additional value of 25.
+		constexpr uint8 HalfFloatHeader = 0xF9;
+
+		// Presents a CborWriter with the interface of a TJsonWriter. Containers are written with an indefinite length,
+		// as their size isn't known up front when streaming.
+		class FCborTokenWriter
+		{
+		public:
+			explicit FCborTokenWriter(FArchive& Archive)
+			  : Writer(&Archive, Endianness) {}
+
+			void WriteObjectStart() { Writer.WriteContainerStart(ECborCode::Map, -1); }
+			void WriteObjectEnd() { Writer.WriteContainerEnd(); }
+			void WriteArrayStart() { Writer.WriteContainerStart(ECborCode::Array, -1); }
+			void WriteArrayEnd() { Writer.WriteContainerEnd(); }
+			void WriteIdentifierPrefix(const FString& Identifier) { Writer.WriteValue(Identifier); }
+			void WriteNull() { Writer.WriteNull(); }
+			void WriteValue(const FString& Value) { Writer.WriteValue(Value); }
+			void WriteValue(const bool Value) { Writer.WriteValue(Value); }
+			void WriteValue(const int64 Value) { Writer.WriteValue(Value); }
+
+			void WriteValue(const double Value)
+			{
+				// Doubles that survive the round trip through a float are written as one, which halves their size.
+				if (static_cast<double>(static_cast<float>(Value)) == Value)
+				{
+					Writer.WriteValue(static_cast<float>(Value));
+				}
+				else
+				{
+					Writer.WriteValue(Value);
+				}
+			}
+
+			void WriteValue(const FString& Identifier, const FString& Value)
+			{
+				WriteIdentifierPrefix(Identifier);
+				WriteValue(Value);
+			}
+
+			void WriteBytes(const TConstArrayView<uint8> Bytes)
+			{
+				Writer.WriteValue(Bytes.GetData(), Bytes.Num());
+			}
+
+			void Close() {}
+
+		private:
+			FCborWriter Writer;
+		};
+
+		// Presents a CborReader with the token interface of a TJsonReader. Byte strings are read as an array, whose
+		// bytes are handed out one number at a time, unless they are consumed whole.
+		class FCborTokenReader
+		{
+		public:
+			explicit FCborTokenReader(FArchive& Archive)
+			  : Stream(Archive), Reader(&Archive, Endianness) {}
+
+			bool ReadNext(EJsonNotation& Notation)
+			{
+				Identifier.Reset();
+
+				if (ByteIndex != INDEX_NONE)
+				{
+					if (ByteIndex < Bytes.Num())
+					{
+						IntegerValue = Bytes[ByteIndex++];
+						IsInteger = true;
+						Notation = EJsonNotation::Number;
+						return true;
+					}
+
+					ByteIndex = INDEX_NONE;
+					Notation = EJsonNotation::ArrayEnd;
+					return true;
+				}
+
+				FCborContext Context;
+				const bool InMap = !Containers.IsEmpty() && Containers.Last().IsMap;
+
+				// Map entries are a key, then a value, so keys are read as the identifier of the value.
+				if (InMap)
+				{
+					if (!ReadContext(Context))
+					{
+						return Fail(Notation);
+					}
+
+					if (Context.IsBreak())
+					{
+						Containers.Pop();
+						Notation = EJsonNotation::ObjectEnd;
+						return true;
+					}
+
+					if (Context.MajorType() != ECborCode::TextString)
+					{
+						ErrorMessage = TEXT("Cbor map keys must be text strings");
+						return Fail(Notation);
+					}
+					Identifier = Context.AsString();
+				}
+
+				if (ReadHalfFloat())
+				{
+					Notation = EJsonNotation::Number;
+					return true;
+				}
+
+				if (!ReadContext(Context))
+				{
+					return Fail(Notation);
+				}
+
+				if (Context.IsBreak())
+				{
+					if (Containers.IsEmpty() || InMap)
+					{
+						ErrorMessage = TEXT("Unexpected end of a Cbor container");
+						return Fail(Notation);
+					}
+					Containers.Pop();
+					Notation = EJsonNotation::ArrayEnd;
+					return true;
+				}
+
+				switch (Context.MajorType())
+				{
+				case ECborCode::Uint:
+					IntegerValue = static_cast<int64>(Context.AsUInt());
+					IsInteger = true;
+					Notation = EJsonNotation::Number;
+					return true;
+				case ECborCode::Int:
+					IntegerValue = Context.AsInt();
+					IsInteger = true;
+					Notation = EJsonNotation::Number;
+					return true;
+				case ECborCode::ByteString:
+					{
+						const TArrayView<const uint8> ByteString = Context.AsByteArray();
+						Bytes.Reset();
+						Bytes.Append(ByteString.GetData(), ByteString.Num());
+						ByteIndex = 0;
+					}
+					Notation = EJsonNotation::ArrayStart;
+					return true;
+				case ECborCode::TextString:
+					StringValue = Context.AsString();
+					Notation = EJsonNotation::String;
+					return true;
+				case ECborCode::Array:
+					Containers.Push({ false, Context.AdditionalValue() == ECborCode::Indefinite });
+					Notation = EJsonNotation::ArrayStart;
+					return true;
+				case ECborCode::Map:
+					Containers.Push({ true, Context.AdditionalValue() == ECborCode::Indefinite });
+					Notation = EJsonNotation::ObjectStart;
+					return true;
+				case ECborCode::Prim:
+					switch (Context.AdditionalValue())
+					{
+					case ECborCode::False:
+					case ECborCode::True:
+						BoolValue = Context.AsBool();
+						Notation = EJsonNotation::Boolean;
+						return true;
+					case ECborCode::Null:
+					case ECborCode::Undefined:
+						Notation = EJsonNotation::Null;
+						return true;
+					case ECborCode::Value_4Bytes:
+						NumberValue = Context.AsFloat();
+						IsInteger = false;
+						Notation = EJsonNotation::Number;
+						return true;
+					case ECborCode::Value_8Bytes:
+						NumberValue = Context.AsDouble();
+						IsInteger = false;
+						Notation = EJsonNotation::Number;
+						return true;
+					default:
+						break;
+					}
+					break;
+				default:
+					break;
+				}
+
+				ErrorMessage = TEXT("Unsupported Cbor value");
+				return Fail(Notation);
+			}
+
+			const FString& GetIdentifier() const { return Identifier; }
+			const FString& GetValueAsString() const { return StringValue; }
+			double GetValueAsNumber() const { return IsInteger ? static_cast<double>(IntegerValue) : NumberValue; }
+			int64 GetValueAsInteger() const { return IsInteger ? IntegerValue : static_cast<int64>(NumberValue); }
+			bool IsIntegerValue() const { return IsInteger; }
+			bool GetValueAsBoolean() const { return BoolValue; }
+			const FString& GetErrorMessage() const { return ErrorMessage; }
+
+			// Is the current array a byte string that hasn't been read yet.
+			bool IsByteString() const { return ByteIndex == 0; }
+
+			// Takes the rest of the current byte string, ending its array. The view is valid until the next byte string.
+			TConstArrayView<uint8> ConsumeByteString()
+			{
+				check(ByteIndex != INDEX_NONE);
+				const TConstArrayView<uint8> Remaining = TConstArrayView<uint8>(Bytes).RightChop(ByteIndex);
+				ByteIndex = INDEX_NONE;
+				return Remaining;
+			}
+
+		private:
+			struct FContainer
+			{
+				bool IsMap = false;
+				bool IsIndefinite = true;
+			};
+
+			// FCborReader doesn't read half-precision floats, which other encoders use for small values, so they are
+			// read here instead. FCborReader counts the elements of fixed length containers, so only values in
+			// containers of an indefinite length, as written by FCborTokenWriter, can be taken from under it.
+			bool ReadHalfFloat()
+			{
+				if (Containers.IsEmpty() || !Containers.Last().IsIndefinite || Stream.AtEnd())
+				{
+					return false;
+				}
+
+				const int64 Start = Stream.Tell();
+				uint8 Header = 0;
+				Stream << Header;
+				if (Header != HalfFloatHeader)
+				{
+					Stream.Seek(Start);
+					return false;
+				}
+
+				uint8 Bits[2] = {};
+				Stream.Serialize(Bits, sizeof(Bits));
+				if (Stream.IsError())
+				{
+					return false;
+				}
+
+				FFloat16 Half;
+				Half.Encoded = static_cast<uint16>(Bits[0] << 8 | Bits[1]);
+				NumberValue = Half.GetFloat();
+				IsInteger = false;
+				return true;
+			}
+
+			bool ReadContext(FCborContext& Context)
+			{
+				if (!Reader.ReadNext(Context) || Context.IsError())
+				{
+					if (ErrorMessage.IsEmpty())
+					{
+						ErrorMessage = TEXT("Invalid Cbor data");
+					}
+					return false;
+				}
+				return true;
+			}
+
+			static bool Fail(EJsonNotation& Notation)
+			{
+				Notation = EJsonNotation::Error;
+				return false;
+			}
+
+			FArchive& Stream;
+			FCborReader Reader;
+
+			TArray<FContainer, TInlineAllocator<16>> Containers;
+
+			FString Identifier;
+			FString StringValue;
+			FString ErrorMessage;
+			int64 IntegerValue = 0;
+			double NumberValue = 0.0;
+			bool IsInteger = false;
+			bool BoolValue = false;
+
+			TArray<uint8> Bytes;
+			int32 ByteIndex = INDEX_NONE;
+		};
+
+		// Copies every token from a reader to a writer, keeping integers exact, and byte strings whole when the
+		// writer can store them.
+		template <class ReaderType, class WriterType>
+		bool Transcode(ReaderType& Reader, WriterType& Writer)
+		{
+			static constexpr bool CanWriteBytes = requires (WriterType& W, TConstArrayView<uint8> Bytes) { W.WriteBytes(Bytes); };
+
+			// Whether each open container is an object.
+			TArray<bool, TInlineAllocator<16>> Containers;
+
+			EJsonNotation Notation;
+			while (Reader.ReadNext(Notation))
+			{
+				const bool InObject = !Containers.IsEmpty() && Containers.Last();
+				if (InObject && Notation != EJsonNotation::ObjectEnd)
+				{
+					Writer.WriteIdentifierPrefix(Reader.GetIdentifier());
+				}
+
+				switch (Notation)
+				{
+				case EJsonNotation::ObjectStart:
+					Writer.WriteObjectStart();
+					Containers.Push(true);
+					continue;
+				case EJsonNotation::ArrayStart:
+					if constexpr (CanWriteBytes && std::is_same_v<ReaderType, FCborTokenReader>)
+					{
+						if (Reader.IsByteString())
+						{
+							Writer.WriteBytes(Reader.ConsumeByteString());
+							break;
+						}
+					}
+					Writer.WriteArrayStart();
+					Containers.Push(false);
+					continue;
+				case EJsonNotation::ObjectEnd:
+					Writer.WriteObjectEnd();
+					Containers.Pop();
+					break;
+				case EJsonNotation::ArrayEnd:
+					Writer.WriteArrayEnd();
+					Containers.Pop();
+					break;
+				case EJsonNotation::String:
+					Writer.WriteValue(Reader.GetValueAsString());
+					break;
+				case EJsonNotation::Number:
+					{
+						if constexpr (std::is_same_v<ReaderType, FCborTokenReader>)
+						{
+							if (Reader.IsIntegerValue())
+							{
+								Writer.WriteValue(Reader.GetValueAsInteger());
+								break;
+							}
+						}
+
+						// Json numbers that are whole, and exact as a double, are written as integers.
+						const double Number = Reader.GetValueAsNumber();
+						const int64 Integer = static_cast<int64>(Number);
+						if (FMath::Abs(Number) <= 9007199254740992.0 && static_cast<double>(Integer) == Number)
+						{
+							Writer.WriteValue(Integer);
+						}
+						else
+						{
+							Writer.WriteValue(Number);
+						}
+					}
+					break;
+				case EJsonNotation::Boolean:
+					Writer.WriteValue(Reader.GetValueAsBoolean());
+					break;
+				case EJsonNotation::Null:
+					Writer.WriteNull();
+					break;
+				default:
+					return false;
+				}
+
+				// The document is done when its outermost container closes.
+				if (Containers.IsEmpty())
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void Generic_ReadData(const UStruct* Struct, const void* Data, TArray<uint8>& OutData, const UObject* Outer)
+		{
+			const int32 Start = OutData.Num();
+
+			FMemoryWriter Archive(OutData);
+			Archive.Seek(Start);
+
+			Json::FOuterTracking KnownOuters;
+			KnownOuters.Add(Outer);
+
+			Json::TJsonStreamExporter<FCborTokenWriter> Exporter(MakeShared<FCborTokenWriter>(Archive), KnownOuters);
+			if (!Exporter.WriteObject(Struct, Data))
+			{
+				UE_LOG(LogJson, Warning, TEXT("Cbor - Unable to write out %s"), *Struct->GetName());
+				OutData.SetNum(Start);
+			}
+		}
+
+		void Generic_WriteData(const UStruct* Struct, void* Memory, const TConstArrayView<uint8> Data, UObject* Container, UObject* Outer)
+		{
+			FMemoryReaderView Archive(Data);
+
+			const TSharedRef<FCborTokenReader> Reader = MakeShared<FCborTokenReader>(Archive);
+			Json::TJsonStreamImporter<FCborTokenReader> Importer(Reader, Outer);
+			if (!Importer.ReadObject(Struct, Memory, Container))
+			{
+				UE_LOG(LogJson, Warning, TEXT("Cbor - Unable to read %s: %s"), *Struct->GetName(), *Reader->GetErrorMessage());
+			}
+		}
+	}
+
+	void FSerializationProvider_Cbor::ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer)
+	{
+		Private::Generic_ReadData(Struct.GetScriptStruct(), Struct.GetMemory(), OutData, Outer);
+	}
+
+	void FSerializationProvider_Cbor::ReadData(const UObject* Object, TArray<uint8>& OutData)
+	{
+		Private::Generic_ReadData(Object->GetClass(), Object, OutData, Object);
+	}
+
+	void FSerializationProvider_Cbor::WriteData(const FStructView& Struct, const TConstArrayView<uint8> Data, UObject* Outer)
+	{
+		if (!ensure(Struct.IsValid()))
+		{
+			return;
+		}
+
+		Private::Generic_WriteData(Struct.GetScriptStruct(), Struct.GetMemory(), Data, nullptr, Outer);
+	}
+
+	void FSerializationProvider_Cbor::WriteData(UObject* Object, const TConstArrayView<uint8> Data)
+	{
+		if (!ensure(IsValid(Object)))
+		{
+			return;
+		}
+
+		Private::Generic_WriteData(Object->GetClass(), Object, Data, Object, Object);
+	}
+
+	bool ConvertFromJson(const FFlake& JsonFlake, FFlake& OutCborFlake, const FReadOptions& Options)
+	{
+		// Flakes from before the provider was stored don't have one, so their payload is checked instead.
+		const bool Legacy = JsonFlake.Header.Provider.IsNone();
+
+		if (!Legacy &&
+			JsonFlake.Header.Provider != Json::Regular::ProviderName &&
+			JsonFlake.Header.Provider != Json::Pretty::ProviderName)
+		{
+			UE_LOG(LogJson, Error, TEXT("ConvertFromJson: Flake is from provider '%s', not Json"), *JsonFlake.Header.Provider.ToString());
+			return false;
+		}
+
+		TArray<uint8> Buffer;
+		TConstArrayView<uint8> Raw;
+		if (!Flakes::Private::DecompressFlake(JsonFlake, Buffer, Raw, FWriteOptions()))
+		{
+			return false;
+		}
+
+		// A json object opens with a brace, which legacy StringToBytes payloads store as a '|'.
+		if (Legacy && (Raw.IsEmpty() || (Raw[0] != '{' && Raw[0] != '|')))
+		{
+			UE_LOG(LogJson, Error, TEXT("ConvertFromJson: Flake has no provider, and its payload isn't Json"));
+			return false;
+		}
+
+		TArray<uint8> CborData;
+		FMemoryWriter Archive(CborData);
+		Private::FCborTokenWriter Writer(Archive);
+
+		if (!Json::VisitJsonPayload(Raw,
+				[&Writer](const auto& JsonReader)
+				{
+					return Private::Transcode(*JsonReader, Writer);
+				}))
+		{
+			UE_LOG(LogJson, Error, TEXT("ConvertFromJson: Unable to parse the Json payload"));
+			return false;
+		}
+
+		OutCborFlake = FFlake();
+		OutCborFlake.Struct = JsonFlake.Struct;
+		OutCborFlake.Header.Provider = FSerializationProvider_Cbor::ProviderName;
+
+#if WITH_EDITOR
+		OutCborFlake.DebugString = Flakes::Private::MakeDebugString(CborData, false);
+#endif
+
+		return Flakes::Private::CompressFlake(OutCborFlake, MoveTemp(CborData), Options);
+	}
+
+	bool ConvertToJson(const FFlake& CborFlake, FFlake& OutJsonFlake, const bool Pretty, const FReadOptions& Options)
+	{
+		if (CborFlake.Header.Provider != FSerializationProvider_Cbor::ProviderName)
+		{
+			UE_LOG(LogJson, Error, TEXT("ConvertToJson: Flake is from provider '%s', not Cbor"), *CborFlake.Header.Provider.ToString());
+			return false;
+		}
+
+		TArray<uint8> Buffer;
+		TConstArrayView<uint8> Raw;
+		if (!Flakes::Private::DecompressFlake(CborFlake, Buffer, Raw, FWriteOptions()))
+		{
+			return false;
+		}
+
+		FMemoryReaderView Reader(Raw);
+		Private::FCborTokenReader CborReader(Reader);
+
+		TArray<uint8> JsonData;
+		FMemoryWriter Archive(JsonData);
+
+		auto WriteJson = [&]<class PrintPolicy>()
+			{
+				const TSharedRef<TJsonWriter<UTF8CHAR, PrintPolicy>> JsonWriter = TJsonWriterFactory<UTF8CHAR, PrintPolicy>::Create(&Archive);
+				const bool Success = Private::Transcode(CborReader, *JsonWriter);
+				JsonWriter->Close();
+				return Success;
+			};
+
+		const bool Success = Pretty ?
+			WriteJson.operator()<TPrettyJsonPrintPolicy<UTF8CHAR>>() :
+			WriteJson.operator()<TCondensedJsonPrintPolicy<UTF8CHAR>>();
+
+		if (!Success)
+		{
+			UE_LOG(LogJson, Error, TEXT("ConvertToJson: Unable to parse the Cbor payload: %s"), *CborReader.GetErrorMessage());
+			return false;
+		}
+
+		OutJsonFlake = FFlake();
+		OutJsonFlake.Struct = CborFlake.Struct;
+		OutJsonFlake.Header.Provider = Pretty ? Json::Pretty::ProviderName : Json::Regular::ProviderName;
+
+#if WITH_EDITOR
+		OutJsonFlake.DebugString = Flakes::Private::MakeDebugString(JsonData, true);
+#endif
+
+		return Flakes::Private::CompressFlake(OutJsonFlake, MoveTemp(JsonData), Options);
+	}
+}
\ No newline at end of file
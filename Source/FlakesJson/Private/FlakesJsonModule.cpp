@@ -1,6 +1,7 @@
 ﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
 
 #include "FlakesJsonModule.h"
+#include "FlakesCborSerializer.h"
 #include "FlakesJsonSerializer.h"
 #include "FlakesModule.h"
 
@@ -10,12 +11,14 @@ void FFlakesJsonModule::StartupModule()
 {
 	FFlakesModule::Get().AddSerializationProvider(MakeUnique<Flakes::Json::Regular>());
 	FFlakesModule::Get().AddSerializationProvider(MakeUnique<Flakes::Json::Pretty>());
+	FFlakesModule::Get().AddSerializationProvider(MakeUnique<Flakes::Cbor::Type>());
 }
 
 void FFlakesJsonModule::ShutdownModule()
 {
 	FFlakesModule::Get().RemoveSerializationProvider(Flakes::Json::Regular::ProviderName);
 	FFlakesModule::Get().RemoveSerializationProvider(Flakes::Json::Pretty::ProviderName);
+	FFlakesModule::Get().RemoveSerializationProvider(Flakes::Cbor::Type::ProviderName);
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -1,6 +1,8 @@
 ﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
 
 #include "FlakesJsonSerializer.h"
+#include "FlakesJsonStream.h"
+#include "FlakesJsonTypeCache.h"
 #include "EngineUpgradeNotice.h"
 #include "GameplayTagContainer.h"
 #include "GameplayTagsManager.h"
@@ -9,6 +11,7 @@
 #include "Engine/World.h"
 
 #include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/MemoryWriter.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(FlakesJsonSerializer)
 
@@ -24,58 +27,6 @@ namespace Flakes::Json
 	static constexpr bool ExportGuidInShortFormat = true;
 #endif
 
-	constexpr int64 CheckFlags = 0;
-	constexpr int64 SkipFlags = 0;
-
-	using FOuterTracking = TSet<const UObject*>;
-
-	namespace CopiedFromJsonObjectConverter
-	{
-		const FString ObjectClassNameKey = "_ClassName";
-	}
-	const FString ObjectStructNameKey = "_StructName";
-
-	// Is this struct property equal to or a child with the same memory layout of a struct.
-	template <typename T>
-	bool IsStructCompatWith(const FStructProperty* Property)
-	{
-		static const UScriptStruct* const BaseGuidStruct = TBaseStructure<T>::Get();
-
-		return Property->Struct->IsChildOf(BaseGuidStruct) &&
-			   Property->Struct->GetPropertiesSize() == BaseGuidStruct->GetPropertiesSize();
-	}
-
-	// Is this struct property a wrapper over a simple numeric type
-	const FNumericProperty* IsNumericWrapperStruct(const FStructProperty* Property)
-	{
-		// DateTime already has custom export in JsonObjectConverter, skip this case.
-		if (IsStructCompatWith<FDateTime>(Property)) return nullptr;
-
-		const FProperty* FirstProperty = nullptr;
-		for (TFieldIterator<FProperty> It(Property->Struct); It; ++It)
-		{
-			if (FirstProperty)
-			{
-				// If we continue iterating, we have hit a second property, and can exit.
-				return nullptr;
-			}
-			FirstProperty = *It;
-		}
-
-		if (FirstProperty)
-		{
-			if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(FirstProperty))
-			{
-				if (!NumericProperty->IsEnum())
-				{
-					return NumericProperty;
-				}
-			}
-		}
-
-		return nullptr;
-	}
-
 	// Copied from ConvertScalarFPropertyToJsonValueWithContainer so we can export to structs directly
 	TSharedPtr<FJsonValue> Flake_ExportNumeric(const FNumericProperty* NumericProperty, const void* Value)
 	{
@@ -109,7 +60,7 @@ namespace Flakes::Json
 			const UEnum* Enum = NumericProperty->GetIntPropertyEnum();
 			check(Enum); // should be assured by IsEnum()
 			FString StrValue = JsonValue->AsString();
-			int64 IntValue = Enum->GetValueOrBitfieldFromString(StrValue, EGetByNameFlags::CheckAuthoredName);
+			int64 IntValue = GetEnumValueFromString(Enum, StrValue);
 			if (IntValue == INDEX_NONE)
 			{
 				//UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to import enum %s from numeric value %s for property %s"), *Enum->CppType, *StrValue, *Property->GetAuthoredName());
@@ -141,42 +92,34 @@ namespace Flakes::Json
 		return false;
 	}
 
-	template<class CharType, class PrintPolicy>
-	bool Flake_UStructToJsonObjectStringInternal(const TSharedRef<FJsonObject>& JsonObject, FString& OutJsonString, int32 Indent)
+	// Finds the struct type an instanced struct was written with, or the default if there isn't one.
+	const UScriptStruct* FindInstancedStructType(const FString& StructString, const UScriptStruct* Default)
 	{
-		TSharedRef<TJsonWriter<CharType, PrintPolicy> > JsonWriter = TJsonWriterFactory<CharType, PrintPolicy>::Create(&OutJsonString, Indent);
-		bool bSuccess = FJsonSerializer::Serialize(JsonObject, JsonWriter);
-		JsonWriter->Close();
-		return bSuccess;
+		if (!StructString.IsEmpty())
+		{
+			const UScriptStruct* FoundStruct = FPackageName::IsShortPackageName(StructString) ?
+				FindFirstObject<UScriptStruct>(*StructString) : LoadObject<UScriptStruct>(nullptr, *StructString);
+			if (FoundStruct)
+			{
+				return FoundStruct;
+			}
+		}
+		return Default;
 	}
 
-	bool Flake_UStructToJsonObjectString(const UStruct* StructDefinition, const void* Struct, FString& OutJsonString,
-		const int64 InCheckFlags, const int64 InSkipFlags, const int32 Indent, const FJsonObjectConverter::CustomExportCallback* ExportCb,
-		const EJsonObjectConversionFlags ConversionFlags, const bool bPrettyPrint)
+	// Finds the class an object was written with, or the default if there isn't one. Copied from JsonObjectConverter.
+	UClass* FindObjectClass(const FString& ClassString, UClass* Default)
 	{
-		TSharedRef<FJsonObject> JsonObject = MakeShared<FJsonObject>();
-		if (FJsonObjectConverter::UStructToJsonObject(StructDefinition, Struct, JsonObject, InCheckFlags, InSkipFlags, ExportCb, ConversionFlags))
+		if (!ClassString.IsEmpty())
 		{
-			bool bSuccess = false;
-			if (bPrettyPrint)
-			{
-				bSuccess = Flake_UStructToJsonObjectStringInternal<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>(JsonObject, OutJsonString, Indent);
-			}
-			else
-			{
-				bSuccess = Flake_UStructToJsonObjectStringInternal<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>(JsonObject, OutJsonString, Indent);
-			}
-			if (bSuccess)
-			{
-				return true;
-			}
-			else
+			UClass* FoundClass = FPackageName::IsShortPackageName(ClassString) ?
+				FindFirstObject<UClass>(*ClassString) : UClass::TryFindTypeSlow<UClass>(ClassString);
+			if (FoundClass)
 			{
-				UE_LOG(LogJson, Warning, TEXT("UStructToJsonObjectString - Unable to write out JSON"));
+				return FoundClass;
 			}
 		}
-
-		return false;
+		return Default;
 	}
 
 	TSharedPtr<FJsonValue> JsonCustomExporter(FProperty* Property, const void* Value, const FJsonObjectConverter::CustomExportCallback* This, FOuterTracking* Outers)
@@ -192,6 +135,8 @@ namespace Flakes::Json
 				return nullptr;
 			}
 
+			const TSharedRef<const FStructInfo> StructInfo = GetStructInfo(StructProperty->Struct);
+
 			/*
 			// Custom Guid Export
 			if (IsStructCompatWith<FGuid>(StructProperty))
@@ -209,13 +154,13 @@ namespace Flakes::Json
 				return nullptr;
 			}
 			// Export Gameplay Tags directly, (skipping internal name export, leading to shorter JSON). Imported will also handle redirects.
-			else */ if (IsStructCompatWith<FGameplayTag>(StructProperty))
+			else */ if (StructInfo->Kind == EStructKind::GameplayTag)
 			{
 				const FGameplayTag* GameplayTag = static_cast<const FGameplayTag*>(Value);
 				return MakeShared<FJsonValueString>(GameplayTag->GetTagName().ToString());
 			}
 			// Export Instanced Structs as an object instead of using ExportTextItem, which the default logic uses.
-			else if (IsStructCompatWith<FInstancedStruct>(StructProperty))
+			else if (StructInfo->Kind == EStructKind::InstancedStruct)
 			{
 				const FInstancedStruct* InstancedStruct = static_cast<const FInstancedStruct*>(Value);
 				TSharedRef<FJsonObject> JsonObject = MakeShared<FJsonObject>();
@@ -236,9 +181,9 @@ namespace Flakes::Json
 
 				return MakeShared<FJsonValueObject>(JsonObject);
 			}
-			else if (const FProperty* OnlyProperty = IsNumericWrapperStruct(StructProperty))
+			else if (StructInfo->Kind == EStructKind::NumericWrapper)
 			{
-				return Flake_ExportNumeric(CastField<FNumericProperty>(OnlyProperty), Value);
+				return Flake_ExportNumeric(StructInfo->NumericProperty, Value);
 			}
 			return nullptr;
 		}
@@ -321,6 +266,8 @@ namespace Flakes::Json
 	{
 		if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
 		{
+			const TSharedRef<const FStructInfo> StructInfo = GetStructInfo(StructProperty->Struct);
+
 			/*
 			// Custom Guid Import
 			if (IsStructCompatWith<FGuid>(StructProperty))
@@ -337,7 +284,7 @@ namespace Flakes::Json
 				}
 			}
 			// Custom Gameplay Tag Import (handles tag redirectors)
-			else*/ if (IsStructCompatWith<FGameplayTag>(StructProperty))
+			else*/ if (StructInfo->Kind == EStructKind::GameplayTag)
 			{
 				if (FString TagStr;
 					JsonValue->TryGetString(TagStr))
@@ -348,7 +295,7 @@ namespace Flakes::Json
 				}
 			}
 			// Custom Instanced Struct Import for those we wrote out as Objects.
-			else if (IsStructCompatWith<FInstancedStruct>(StructProperty))
+			else if (StructInfo->Kind == EStructKind::InstancedStruct)
 			{
 				if (const TSharedPtr<FJsonObject>* JsonObject = nullptr;
 					JsonValue->TryGetObject(JsonObject))
@@ -357,20 +304,10 @@ namespace Flakes::Json
 
 					constexpr bool bStrictMode = false;
 
-					const UScriptStruct* PropertyStruct = StructProperty->Struct;
-
 					// If a specific subclass was stored in the JSON, use that instead of the PropertyClass
 					const FString StructString = Obj->GetStringField(ObjectStructNameKey);
 					Obj->RemoveField(ObjectStructNameKey);
-					if (!StructString.IsEmpty())
-					{
-						const UScriptStruct* FoundClass = FPackageName::IsShortPackageName(StructString) ?
-							FindFirstObject<UScriptStruct>(*StructString) : LoadObject<UScriptStruct>(nullptr, *StructString);
-						if (FoundClass)
-						{
-							PropertyStruct = FoundClass;
-						}
-					}
+					const UScriptStruct* PropertyStruct = FindInstancedStructType(StructString, StructProperty->Struct);
 
 					FInstancedStruct* InstancedStruct = static_cast<FInstancedStruct*>(Value);
 					InstancedStruct->InitializeAs(PropertyStruct);
@@ -387,10 +324,10 @@ namespace Flakes::Json
 					}
 				}
 			}
-			else if (const FNumericProperty* OnlyProperty = IsNumericWrapperStruct(StructProperty))
+			else if (StructInfo->Kind == EStructKind::NumericWrapper)
 			{
 				// Export structs containing only a single numeric value as a number instead of an object.
-				return Flake_ImportNumeric(JsonValue, CastField<FNumericProperty>(OnlyProperty), Value);
+				return Flake_ImportNumeric(JsonValue, StructInfo->NumericProperty, Value);
 			}
 		}
 
@@ -404,7 +341,7 @@ namespace Flakes::Json
 				const UEnum* Enum = EnumProperty->GetEnum();
 				check(Enum);
 				FString StrValue = JsonValue->AsString();
-				int64 IntValue = Enum->GetValueOrBitfieldFromString(StrValue, EGetByNameFlags::CheckAuthoredName);
+				int64 IntValue = GetEnumValueFromString(Enum, StrValue);
 				if (IntValue == INDEX_NONE)
 				{
 					UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to import enum %s from string value %s for property %s"), *Enum->CppType, *StrValue, *Property->GetAuthoredName());
@@ -430,7 +367,7 @@ namespace Flakes::Json
 				const UEnum* Enum = NumericProperty->GetIntPropertyEnum();
 				check(Enum); // should be assured by IsEnum()
 				FString StrValue = JsonValue->AsString();
-				int64 IntValue = Enum->GetValueOrBitfieldFromString(StrValue, EGetByNameFlags::CheckAuthoredName);
+				int64 IntValue = GetEnumValueFromString(Enum, StrValue);
 				if (IntValue == INDEX_NONE)
 				{
 					UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to import enum %s from numeric value %s for property %s"), *Enum->CppType, *StrValue, *Property->GetAuthoredName());
@@ -449,115 +386,94 @@ namespace Flakes::Json
 		return FJsonObjectConverter::CustomImportCallback::CreateStatic(&JsonCustomImporter, This, Outer);
 	}
 
-	void Generic_ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer, const bool UsePrettyPrint)
+	// Writes the json as UTF-8, straight onto the end of the payload.
+	template <class PrintPolicy>
+	bool StreamToJson(const UStruct* Struct, const void* Data, FOuterTracking& Outers, TArray<uint8>& OutData)
 	{
-		static constexpr EJsonObjectConversionFlags ConversionFlags = EJsonObjectConversionFlags::WriteTextAsComplexString;
+		const int32 Start = OutData.Num();
+
+		// Json is rarely smaller than the memory it describes, so this saves most of the early reallocations.
+		OutData.Reserve(Start + Struct->GetPropertiesSize() * 2);
+
+		FMemoryWriter Archive(OutData);
+		Archive.Seek(Start);
+
+		const TSharedRef<TJsonWriter<UTF8CHAR, PrintPolicy>> JsonWriter = TJsonWriterFactory<UTF8CHAR, PrintPolicy>::Create(&Archive);
+		TJsonStreamExporter<TJsonWriter<UTF8CHAR, PrintPolicy>> Exporter(JsonWriter, Outers);
+		const bool Success = Exporter.WriteObject(Struct, Data);
+		JsonWriter->Close();
+
+		if (!Success)
+		{
+			OutData.SetNum(Start);
+		}
+		return Success;
+	}
 
+	void Generic_ReadData(const UStruct* Struct, const void* Data, TArray<uint8>& OutData, const UObject* Outer, const bool UsePrettyPrint)
+	{
 		FOuterTracking KnownOuters;
 		KnownOuters.Add(Outer);
-		FJsonObjectConverter::CustomExportCallback CustomExporter;
-		CustomExporter = MakeJsonCustomExporter(&CustomExporter, &KnownOuters);
-
-		FString StringData;
-		Flake_UStructToJsonObjectString(Struct.GetScriptStruct(), Struct.GetMemory(),
-			StringData,
-			CheckFlags,
-			SkipFlags,
-			0,
-			&CustomExporter,
-			ConversionFlags,
-			UsePrettyPrint);
-
-		OutData.AddUninitialized(StringData.Len());
-		StringToBytes(StringData, OutData.GetData(), StringData.Len());
+
+		const bool Success = UsePrettyPrint ?
+			StreamToJson<TPrettyJsonPrintPolicy<UTF8CHAR>>(Struct, Data, KnownOuters, OutData) :
+			StreamToJson<TCondensedJsonPrintPolicy<UTF8CHAR>>(Struct, Data, KnownOuters, OutData);
+
+		if (!Success)
+		{
+			UE_LOG(LogJson, Warning, TEXT("UStructToJsonObjectString - Unable to write out JSON"));
+		}
 	}
 
-	void Generic_ReadData(const UObject* Object, TArray<uint8>& OutData, const bool UsePrettyPrint)
+	void Generic_ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer, const bool UsePrettyPrint)
 	{
-		static constexpr EJsonObjectConversionFlags ConversionFlags = EJsonObjectConversionFlags::WriteTextAsComplexString;
+		Generic_ReadData(Struct.GetScriptStruct(), Struct.GetMemory(), OutData, Outer, UsePrettyPrint);
+	}
 
-		FOuterTracking KnownOuters;
-		KnownOuters.Add(Object);
-		FJsonObjectConverter::CustomExportCallback CustomExporter;
-		CustomExporter = MakeJsonCustomExporter(&CustomExporter, &KnownOuters);
-
-		FString StringData;
-		Flake_UStructToJsonObjectString(Object->GetClass(), Object,
-			StringData,
-			CheckFlags,
-			SkipFlags,
-			0,
-			&CustomExporter,
-			ConversionFlags,
-			UsePrettyPrint);
-
-		OutData.AddUninitialized(StringData.Len());
-		StringToBytes(StringData, OutData.GetData(), StringData.Len());
+	void Generic_ReadData(const UObject* Object, TArray<uint8>& OutData, const bool UsePrettyPrint)
+	{
+		Generic_ReadData(Object->GetClass(), Object, OutData, Object, UsePrettyPrint);
 	}
 
-	void Generic_WriteData(const FStructView& Struct, const TArray<uint8>& Data, UObject* Outer)
+	template <class CharType>
+	bool StreamFromJson(const TSharedRef<TJsonReader<CharType>>& JsonReader, const UStruct* Struct, void* Memory, UObject* Container, UObject* Outer)
 	{
-		if (!ensure(Struct.IsValid()))
+		TJsonStreamImporter<TJsonReader<CharType>> Importer(JsonReader, Outer);
+		if (!Importer.ReadObject(Struct, Memory, Container))
 		{
-			return;
+			UE_LOG(LogJson, Warning, TEXT("JsonObjectStringToUStruct - Unable to read JSON: %s"), *JsonReader->GetErrorMessage());
+			return false;
 		}
+		return true;
+	}
 
-		TSharedPtr<FJsonObject> JsonObject = nullptr;
-		{
-			TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(BytesToString(Data.GetData(), Data.Num()));
-			if (!FJsonSerializer::Deserialize(JsonReader, JsonObject) || !JsonObject.IsValid())
+	bool StreamFromJson(const TConstArrayView<uint8> Data, const UStruct* Struct, void* Memory, UObject* Container, UObject* Outer)
+	{
+		return VisitJsonPayload(Data,
+			[&](const auto& JsonReader)
 			{
-				return;
-			}
-		}
-
-		constexpr bool bStrictMode = false;
-
-		FJsonObjectConverter::CustomImportCallback CustomImporter;
-		CustomImporter = MakeJsonCustomImporter(&CustomImporter, Outer);
-
-		FJsonObjectConverter::JsonObjectToUStruct(
-			JsonObject.ToSharedRef(),
-			Struct.GetScriptStruct(),
-			Struct.GetMemory(),
-			CheckFlags,
-			SkipFlags,
-			bStrictMode,
-			nullptr,
-			&CustomImporter);
+				return StreamFromJson(JsonReader, Struct, Memory, Container, Outer);
+			});
 	}
 
-	void Generic_WriteData(UObject* Object, const TArray<uint8>& Data)
+	void Generic_WriteData(const FStructView& Struct, const TConstArrayView<uint8> Data, UObject* Outer)
 	{
-		if (!ensure(IsValid(Object)))
+		if (!ensure(Struct.IsValid()))
 		{
 			return;
 		}
 
-		TSharedPtr<FJsonObject> JsonObject = nullptr;
+		StreamFromJson(Data, Struct.GetScriptStruct(), Struct.GetMemory(), nullptr, Outer);
+	}
+
+	void Generic_WriteData(UObject* Object, const TConstArrayView<uint8> Data)
+	{
+		if (!ensure(IsValid(Object)))
 		{
-			const FString JsonString = BytesToString(Data.GetData(), Data.Num());
-			const TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(JsonString);
-			if (!FJsonSerializer::Deserialize(JsonReader, JsonObject) || !JsonObject.IsValid())
-			{
-				return;
-			}
+			return;
 		}
 
-		constexpr bool bStrictMode = false;
-
-		FJsonObjectConverter::CustomImportCallback CustomImporter;
-		CustomImporter = MakeJsonCustomImporter(&CustomImporter, Object);
-
-		FJsonObjectConverter::JsonObjectToUStruct(
-			JsonObject.ToSharedRef(),
-			Object->GetClass(),
-			Object,
-			CheckFlags,
-			SkipFlags,
-			bStrictMode,
-			nullptr,
-			&CustomImporter);
+		StreamFromJson(Data, Object->GetClass(), Object, Object, Object);
 	}
 
 	void FSerializationProvider_Json::ReadData(const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer)
@@ -570,12 +486,12 @@ namespace Flakes::Json
 		Generic_ReadData(Object, OutData, false);
 	}
 
-	void FSerializationProvider_Json::WriteData(const FStructView& Struct, const TArray<uint8>& Data, UObject* Outer)
+	void FSerializationProvider_Json::WriteData(const FStructView& Struct, const TConstArrayView<uint8> Data, UObject* Outer)
 	{
 		Generic_WriteData(Struct, Data, Outer);
 	}
 
-	void FSerializationProvider_Json::WriteData(UObject* Object, const TArray<uint8>& Data)
+	void FSerializationProvider_Json::WriteData(UObject* Object, const TConstArrayView<uint8> Data)
 	{
 		Generic_WriteData(Object, Data);
 	}
@@ -590,12 +506,12 @@ namespace Flakes::Json
 		Generic_ReadData(Object, OutData, true);
 	}
 
-	void FSerializationProvider_PrettyJson::WriteData(const FStructView& Struct, const TArray<uint8>& Data, UObject* Outer)
+	void FSerializationProvider_PrettyJson::WriteData(const FStructView& Struct, const TConstArrayView<uint8> Data, UObject* Outer)
 	{
 		Generic_WriteData(Struct, Data, Outer);
 	}
 
-	void FSerializationProvider_PrettyJson::WriteData(UObject* Object, const TArray<uint8>& Data)
+	void FSerializationProvider_PrettyJson::WriteData(UObject* Object, const TConstArrayView<uint8> Data)
 	{
 		Generic_WriteData(Object, Data);
 	}
@@ -0,0 +1,1206 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "FlakesJsonTypeCache.h"
+#include "GameplayTagContainer.h"
+#include "JsonObjectConverter.h"
+#include "JsonObjectWrapper.h"
+#include "Engine/World.h"
+#include "Misc/ScopeExit.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "StructUtils/InstancedStruct.h"
+
+// The streaming exporter and importer behind the Json providers, shared with the Cbor provider.
+namespace Flakes::Json
+{
+	constexpr int64 CheckFlags = 0;
+	constexpr int64 SkipFlags = 0;
+
+	using FOuterTracking = TSet<const UObject*>;
+
+	namespace CopiedFromJsonObjectConverter
+	{
+		inline const FString ObjectClassNameKey = "_ClassName";
+	}
+	inline const FString ObjectStructNameKey = "_StructName";
+
+	const UScriptStruct* FindInstancedStructType(const FString& StructString, const UScriptStruct* Default);
+	UClass* FindObjectClass(const FString& ClassString, UClass* Default);
+
+	FJsonObjectConverter::CustomExportCallback MakeJsonCustomExporter(const FJsonObjectConverter::CustomExportCallback* This, FOuterTracking* Outers);
+	bool JsonCustomImporter(const TSharedPtr<FJsonValue>& JsonValue, FProperty* Property, void* Value, const FJsonObjectConverter::CustomImportCallback* This, UObject* Outer);
+	FJsonObjectConverter::CustomImportCallback MakeJsonCustomImporter(const FJsonObjectConverter::CustomImportCallback* This, UObject* Outer);
+
+	// Calls the visitor with a json reader for a payload. Payloads from before json was written as UTF-8 went through
+	// StringToBytes, which offsets every character by one, so their opening brace reads as a '|'.
+	template <typename TVisitor>
+	bool VisitJsonPayload(const TConstArrayView<uint8> Data, TVisitor&& Visitor)
+	{
+		if (!Data.IsEmpty() && Data[0] == '|')
+		{
+			const TSharedRef<TJsonReader<TCHAR>> JsonReader = TJsonReaderFactory<>::Create(BytesToString(Data.GetData(), Data.Num()));
+			return Visitor(JsonReader);
+		}
+
+		const FUtf8StringView JsonString(reinterpret_cast<const UTF8CHAR*>(Data.GetData()), Data.Num());
+		const TSharedRef<TJsonReader<UTF8CHAR>> JsonReader = TJsonReaderFactory<UTF8CHAR>::CreateFromView(JsonString);
+		return Visitor(JsonReader);
+	}
+
+	template <class T> constexpr bool TIsJsonWriter = false;
+	template <class CharType, class PrintPolicy> constexpr bool TIsJsonWriter<TJsonWriter<CharType, PrintPolicy>> = true;
+
+	// Byte arrays that aren't enums, which binary formats can store as raw bytes.
+	inline bool IsPlainByteProperty(const FProperty* Property)
+	{
+		const FByteProperty* ByteProperty = CastField<FByteProperty>(Property);
+		return ByteProperty && !ByteProperty->Enum;
+	}
+
+	/*
+	 * Streams a struct or object straight from its properties into a json writer, without building an FJsonObject
+	 * first. This follows the same rules as FJsonObjectConverter::UStructToJsonObject with JsonCustomExporter. The
+	 * writer is a TJsonWriter, or anything with the same interface, such as the Cbor writer.
+	 */
+	template <class WriterType>
+	class TJsonStreamExporter
+	{
+	public:
+		using FWriter = WriterType;
+
+		TJsonStreamExporter(const TSharedRef<FWriter>& InWriter, FOuterTracking& InOuters)
+		  : Writer(InWriter),
+			Outers(InOuters)
+		{
+			CustomExporter = MakeJsonCustomExporter(&CustomExporter, &Outers);
+		}
+
+		// Writes the properties of the struct as an object.
+		bool WriteObject(const UStruct* Struct, const void* Data)
+		{
+			Writer->WriteObjectStart();
+			const bool Success = WriteFields(Struct, Data);
+			Writer->WriteObjectEnd();
+			return Success;
+		}
+
+	private:
+		enum class ECustomResult : uint8
+		{
+			Unhandled,
+			Written,
+			Failed
+		};
+
+		static constexpr bool CanWriteBytes = requires (FWriter& W, TConstArrayView<uint8> Bytes) { W.WriteBytes(Bytes); };
+
+		void WriteJsonField(const FString& Identifier, const TSharedPtr<FJsonValue>& Value)
+		{
+			if constexpr (TIsJsonWriter<FWriter>)
+			{
+				FJsonSerializer::Serialize(Value, Identifier, Writer, false);
+			}
+			else
+			{
+				Writer->WriteIdentifierPrefix(Identifier);
+				WriteJsonValue(Value);
+			}
+		}
+
+		void WriteJsonValue(const TSharedPtr<FJsonValue>& Value)
+		{
+			switch (Value.IsValid() ? Value->Type : EJson::Null)
+			{
+			case EJson::String:
+				Writer->WriteValue(Value->AsString());
+				break;
+			case EJson::Number:
+				Writer->WriteValue(Value->AsNumber());
+				break;
+			case EJson::Boolean:
+				Writer->WriteValue(Value->AsBool());
+				break;
+			case EJson::Array:
+				Writer->WriteArrayStart();
+				for (const TSharedPtr<FJsonValue>& Element : Value->AsArray())
+				{
+					WriteJsonValue(Element);
+				}
+				Writer->WriteArrayEnd();
+				break;
+			case EJson::Object:
+				Writer->WriteObjectStart();
+				for (const TPair<FString, TSharedPtr<FJsonValue>>& Field : Value->AsObject()->Values)
+				{
+					WriteJsonField(Field.Key, Field.Value);
+				}
+				Writer->WriteObjectEnd();
+				break;
+			default:
+				Writer->WriteNull();
+				break;
+			}
+		}
+
+		bool WriteFields(const UStruct* Struct, const void* Data)
+		{
+			if (Struct == FJsonObjectWrapper::StaticStruct())
+			{
+				// Wrapped json is copied in as is.
+				if (const TSharedPtr<FJsonObject>& JsonObject = static_cast<const FJsonObjectWrapper*>(Data)->JsonObject)
+				{
+					for (const TPair<FString, TSharedPtr<FJsonValue>>& Field : JsonObject->Values)
+					{
+						WriteJsonField(Field.Key, Field.Value);
+					}
+				}
+				return true;
+			}
+
+			// With no skip flags, the converter skips these by default.
+			constexpr EPropertyFlags DefaultSkipFlags = CPF_Deprecated | CPF_Transient;
+
+			for (TFieldIterator<FProperty> It(Struct); It; ++It)
+			{
+				FProperty* Property = *It;
+				if (Property->HasAnyPropertyFlags(DefaultSkipFlags))
+				{
+					continue;
+				}
+
+				Writer->WriteIdentifierPrefix(FJsonObjectConverter::StandardizeCase(Property->GetAuthoredName()));
+
+				const void* Value = Property->ContainerPtrToValuePtr<uint8>(Data);
+				if (Property->GetArrayDim() == 1)
+				{
+					if (!WriteValue(Property, Value)) return false;
+				}
+				else
+				{
+					Writer->WriteArrayStart();
+					for (int32 Index = 0; Index < Property->GetArrayDim(); ++Index)
+					{
+						if (!WriteValue(Property, static_cast<const uint8*>(Value) + Index * Property->GetElementSize())) return false;
+					}
+					Writer->WriteArrayEnd();
+				}
+			}
+
+			return true;
+		}
+
+		void WriteNumeric(const FNumericProperty* NumericProperty, const void* Value)
+		{
+			if (const UEnum* EnumDef = NumericProperty->GetIntPropertyEnum())
+			{
+				Writer->WriteValue(EnumDef->GetValueOrBitfieldAsAuthoredNameString(NumericProperty->GetSignedIntPropertyValue(Value)));
+			}
+			else if (NumericProperty->IsFloatingPoint())
+			{
+				Writer->WriteValue(NumericProperty->GetFloatingPointPropertyValue(Value));
+			}
+			else
+			{
+				Writer->WriteValue(NumericProperty->GetSignedIntPropertyValue(Value));
+			}
+		}
+
+		// The streaming version of JsonCustomExporter.
+		ECustomResult WriteCustom(FProperty* Property, const void* Value)
+		{
+			if (CastField<FMulticastDelegateProperty>(Property))
+			{
+				Writer->WriteNull();
+				return ECustomResult::Written;
+			}
+
+			if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+			{
+				if (!IsValid(StructProperty->Struct))
+				{
+					return ECustomResult::Unhandled;
+				}
+
+				const TSharedRef<const FStructInfo> StructInfo = GetStructInfo(StructProperty->Struct);
+
+				if (StructInfo->Kind == EStructKind::GameplayTag)
+				{
+					Writer->WriteValue(static_cast<const FGameplayTag*>(Value)->GetTagName().ToString());
+					return ECustomResult::Written;
+				}
+
+				if (StructInfo->Kind == EStructKind::InstancedStruct)
+				{
+					const FInstancedStruct* InstancedStruct = static_cast<const FInstancedStruct*>(Value);
+
+					Writer->WriteObjectStart();
+					bool Success = true;
+					if (const UScriptStruct* ScriptStruct = InstancedStruct->GetScriptStruct())
+					{
+						Writer->WriteValue(ObjectStructNameKey, ScriptStruct->GetPathName());
+						if (const uint8* Memory = InstancedStruct->GetMemory())
+						{
+							Success = WriteFields(ScriptStruct, Memory);
+						}
+					}
+					Writer->WriteObjectEnd();
+					return Success ? ECustomResult::Written : ECustomResult::Failed;
+				}
+
+				if (const FNumericProperty* OnlyProperty = StructInfo->NumericProperty)
+				{
+					if (OnlyProperty->GetIntPropertyEnum() || OnlyProperty->IsFloatingPoint() || OnlyProperty->IsInteger())
+					{
+						WriteNumeric(OnlyProperty, Value);
+						return ECustomResult::Written;
+					}
+				}
+
+				return ECustomResult::Unhandled;
+			}
+
+			if (const FObjectProperty* ObjectProperty = CastField<FObjectProperty>(Property))
+			{
+				const UObject* Object = ObjectProperty->GetObjectPropertyValue(Value);
+				if (!IsValid(Object))
+				{
+					return ECustomResult::Unhandled;
+				}
+
+				if (Outers.Contains(Object))
+				{
+					// Object is already being serialized, just export the path.
+					FString StringValue;
+					Property->ExportTextItem_Direct(StringValue, Value, nullptr, nullptr, PPF_None);
+					Writer->WriteValue(StringValue);
+					return ECustomResult::Written;
+				}
+
+				if (Object->HasAnyFlags(RF_WasLoaded | RF_LoadCompleted))
+				{
+					return ECustomResult::Unhandled;
+				}
+
+				if (Outers.Contains(Object->GetOuter()) || Object->GetTypedOuter<UWorld>())
+				{
+					Outers.Add(Object);
+
+					Writer->WriteObjectStart();
+					Writer->WriteValue(CopiedFromJsonObjectConverter::ObjectClassNameKey, Object->GetClass()->GetPathName());
+					const bool Success = WriteFields(Object->GetClass(), Object);
+					Writer->WriteObjectEnd();
+					return Success ? ECustomResult::Written : ECustomResult::Failed;
+				}
+
+				return ECustomResult::Unhandled;
+			}
+
+			if (const FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+			{
+				Writer->WriteValue(EnumProperty->GetEnum()->GetValueOrBitfieldAsAuthoredNameString(
+					EnumProperty->GetUnderlyingProperty()->GetSignedIntPropertyValue(Value)));
+				return ECustomResult::Written;
+			}
+
+			return ECustomResult::Unhandled;
+		}
+
+		// The streaming version of ConvertScalarFPropertyToJsonValue.
+		bool WriteValue(FProperty* Property, const void* Value)
+		{
+			switch (WriteCustom(Property, Value))
+			{
+			case ECustomResult::Written: return true;
+			case ECustomResult::Failed: return false;
+			default: break;
+			}
+
+			if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+			{
+				WriteNumeric(NumericProperty, Value);
+			}
+			else if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+			{
+				Writer->WriteValue(BoolProperty->GetPropertyValue(Value));
+			}
+			else if (const FStrProperty* StringProperty = CastField<FStrProperty>(Property))
+			{
+				Writer->WriteValue(StringProperty->GetPropertyValue(Value));
+			}
+			else if (const FTextProperty* TextProperty = CastField<FTextProperty>(Property))
+			{
+				// Matches EJsonObjectConversionFlags::WriteTextAsComplexString
+				FString TextValueString;
+				FTextStringHelper::WriteToBuffer(TextValueString, TextProperty->GetPropertyValue(Value));
+				Writer->WriteValue(TextValueString);
+			}
+			else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+			{
+				FScriptArrayHelper Helper(ArrayProperty, Value);
+
+				// Writers that can store bytes natively get byte arrays whole.
+				if constexpr (CanWriteBytes)
+				{
+					if (IsPlainByteProperty(ArrayProperty->Inner))
+					{
+						Writer->WriteBytes(TConstArrayView<uint8>(Helper.GetRawPtr(), Helper.Num()));
+						return true;
+					}
+				}
+
+				Writer->WriteArrayStart();
+				for (int32 Index = 0; Index < Helper.Num(); ++Index)
+				{
+					if (!WriteValue(ArrayProperty->Inner, Helper.GetRawPtr(Index))) return false;
+				}
+				Writer->WriteArrayEnd();
+			}
+			else if (const FSetProperty* SetProperty = CastField<FSetProperty>(Property))
+			{
+				FScriptSetHelper Helper(SetProperty, Value);
+				Writer->WriteArrayStart();
+				for (FScriptSetHelper::FIterator It(Helper); It; ++It)
+				{
+					if (!WriteValue(SetProperty->ElementProp, Helper.GetElementPtr(It))) return false;
+				}
+				Writer->WriteArrayEnd();
+			}
+			else if (const FMapProperty* MapProperty = CastField<FMapProperty>(Property))
+			{
+				FScriptMapHelper Helper(MapProperty, Value);
+				Writer->WriteObjectStart();
+				for (FScriptMapHelper::FIterator It(Helper); It; ++It)
+				{
+					Writer->WriteIdentifierPrefix(GetKeyString(MapProperty->KeyProp, Helper.GetKeyPtr(It), It.GetLogicalIndex()));
+					if (!WriteValue(MapProperty->ValueProp, Helper.GetValuePtr(It))) return false;
+				}
+				Writer->WriteObjectEnd();
+			}
+			else if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+			{
+				// Structs that can export themselves as text are written as strings, except for wrapped json.
+				if (const TSharedRef<const FStructInfo> StructInfo = GetStructInfo(StructProperty->Struct);
+					StructInfo->Kind != EStructKind::JsonObjectWrapper && StructInfo->HasExportTextItem)
+				{
+					FString StringValue;
+					StructProperty->Struct->GetCppStructOps()->ExportTextItem(StringValue, Value, nullptr, nullptr, PPF_None, nullptr);
+					Writer->WriteValue(StringValue);
+				}
+				else if (!WriteObject(StructProperty->Struct, Value))
+				{
+					return false;
+				}
+			}
+			else if (const FObjectProperty* ObjectProperty = CastField<FObjectProperty>(Property);
+				ObjectProperty && ObjectProperty->HasAnyPropertyFlags(CPF_PersistentInstance) &&
+				ObjectProperty->GetObjectPropertyValue(Value))
+			{
+				// Instanced objects are written by value.
+				const UObject* Object = ObjectProperty->GetObjectPropertyValue(Value);
+				Writer->WriteObjectStart();
+				Writer->WriteValue(CopiedFromJsonObjectConverter::ObjectClassNameKey, Object->GetClass()->GetPathName());
+				const bool Success = WriteFields(Object->GetClass(), Object);
+				Writer->WriteObjectEnd();
+				return Success;
+			}
+			else
+			{
+				// Everything else is exported as text.
+				FString StringValue;
+				Property->ExportTextItem_Direct(StringValue, Value, nullptr, nullptr, PPF_None);
+				Writer->WriteValue(StringValue);
+			}
+
+			return true;
+		}
+
+		// Map keys are always strings, so they go through the converter, which is cheap for the types keys can be.
+		FString GetKeyString(FProperty* KeyProperty, const void* Key, const int32 Index)
+		{
+			FString KeyString;
+			const TSharedPtr<FJsonValue> KeyValue = FJsonObjectConverter::UPropertyToJsonValue(KeyProperty, Key,
+				CheckFlags, SkipFlags, &CustomExporter, nullptr, EJsonObjectConversionFlags::WriteTextAsComplexString);
+			if (!KeyValue.IsValid() || !KeyValue->TryGetString(KeyString))
+			{
+				KeyProperty->ExportTextItem_Direct(KeyString, Key, nullptr, nullptr, PPF_None);
+				if (KeyString.IsEmpty())
+				{
+					KeyString = FString::Printf(TEXT("Unparsed Key %d"), Index);
+				}
+			}
+
+			// Like the converter, enum and name keys are coerced to camelCase.
+			if (KeyProperty->IsA<FEnumProperty>() || KeyProperty->IsA<FNameProperty>())
+			{
+				KeyString = FJsonObjectConverter::StandardizeCase(KeyString);
+			}
+			return KeyString;
+		}
+
+		TSharedRef<FWriter> Writer;
+		FOuterTracking& Outers;
+		FJsonObjectConverter::CustomExportCallback CustomExporter;
+	};
+
+	/*
+	 * Streams a json document straight into the properties of a struct or object, without building an FJsonObject
+	 * first. This follows the same rules as FJsonObjectConverter::JsonObjectToUStruct with JsonCustomImporter. Values
+	 * in a shape the exporter never writes (such as a class name that isn't the first field) are parsed on their own
+	 * and handed to the converter.
+	 */
+	template <class ReaderType>
+	class TJsonStreamImporter
+	{
+	public:
+		using FReader = ReaderType;
+
+		TJsonStreamImporter(const TSharedRef<FReader>& InReader, UObject* Outer)
+		  : Reader(InReader)
+		{
+			CustomImporter = MakeJsonCustomImporter(&CustomImporter, Outer);
+		}
+
+		// Reads a whole document into the properties of the struct. Container is the object that owns the data, if any.
+		bool ReadObject(const UStruct* Struct, void* Data, UObject* Container)
+		{
+			EJsonNotation Notation;
+			if (!Reader->ReadNext(Notation) || Notation != EJsonNotation::ObjectStart)
+			{
+				return false;
+			}
+			return ReadFields(Struct, Data, Container);
+		}
+
+	private:
+		enum class ECustomResult : uint8
+		{
+			Unhandled,
+			Read,
+			Failed
+		};
+
+		// Readers of binary formats can hand over byte strings whole, and keep integers exact.
+		static constexpr bool CanReadBytes = requires (FReader& R) { R.IsByteString(); R.ConsumeByteString(); };
+		static constexpr bool CanReadIntegers = requires (const FReader& R) { R.GetValueAsInteger(); };
+
+		static bool IsScalar(const EJsonNotation Notation)
+		{
+			return Notation == EJsonNotation::String || Notation == EJsonNotation::Number || Notation == EJsonNotation::Boolean;
+		}
+
+		// Reads the fields of an object, after its start has been read.
+		bool ReadFields(const UStruct* Struct, void* Data, UObject* Container)
+		{
+			const TSharedRef<const FStructInfo> StructInfo = GetStructInfo(Struct);
+
+			if (StructInfo->Kind == EStructKind::JsonObjectWrapper)
+			{
+				// Wrapped json is kept as is.
+				const TSharedRef<FJsonObject> JsonObject = MakeShared<FJsonObject>();
+				if (!ParseFields(*JsonObject))
+				{
+					return false;
+				}
+				static_cast<FJsonObjectWrapper*>(Data)->JsonObject = JsonObject;
+				return true;
+			}
+
+			EJsonNotation Notation;
+			while (Reader->ReadNext(Notation))
+			{
+				if (Notation == EJsonNotation::ObjectEnd)
+				{
+					return true;
+				}
+
+				FProperty* const* Property = StructInfo->Properties.Find(Reader->GetIdentifier());
+				if (!Property)
+				{
+					// Fields without a property are ignored, like any other missing data.
+					if (!SkipValue(Notation)) return false;
+					continue;
+				}
+
+				if (Notation == EJsonNotation::Null)
+				{
+					continue;
+				}
+
+				if (!ReadProperty(*Property, (*Property)->ContainerPtrToValuePtr<void>(Data), Notation, Container))
+				{
+					UE_LOG(LogJson, Error, TEXT("JsonObjectToUStruct - Unable to parse %s.%s from JSON"), *Struct->GetAuthoredName(), *(*Property)->GetAuthoredName());
+					return false;
+				}
+			}
+
+			return false;
+		}
+
+		// The streaming version of JsonValueToFPropertyWithContainer.
+		bool ReadProperty(FProperty* Property, void* Value, const EJsonNotation Notation, UObject* Container)
+		{
+			const bool ArrayOrSet = Property->IsA<FArrayProperty>() || Property->IsA<FSetProperty>();
+
+			if (Notation != EJsonNotation::ArrayStart)
+			{
+				if (ArrayOrSet)
+				{
+					UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Attempted to import TArray from non-array JSON key"));
+					return false;
+				}
+				return ReadValue(Property, Value, Notation, Container);
+			}
+
+			if (ArrayOrSet && Property->GetArrayDim() == 1)
+			{
+				return ReadValue(Property, Value, Notation, Container);
+			}
+
+			// Reading into a static array, where elements past its size are ignored.
+			int32 Index = 0;
+			EJsonNotation ElementNotation;
+			while (Reader->ReadNext(ElementNotation))
+			{
+				if (ElementNotation == EJsonNotation::ArrayEnd)
+				{
+					return true;
+				}
+
+				if (Index < Property->GetArrayDim() && ElementNotation != EJsonNotation::Null)
+				{
+					if (!ReadValue(Property, static_cast<uint8*>(Value) + Index * Property->GetElementSize(), ElementNotation, Container)) return false;
+				}
+				else if (!SkipValue(ElementNotation))
+				{
+					return false;
+				}
+				++Index;
+			}
+
+			return false;
+		}
+
+		bool ReadEnum(const UEnum* Enum, const FNumericProperty* UnderlyingProperty, void* Value, const EJsonNotation Notation)
+		{
+			if (Notation == EJsonNotation::String)
+			{
+				const FString& StrValue = Reader->GetValueAsString();
+				const int64 IntValue = GetEnumValueFromString(Enum, StrValue);
+				if (IntValue == INDEX_NONE)
+				{
+					UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to import enum %s from string value %s"), *Enum->CppType, *StrValue);
+					return false;
+				}
+				UnderlyingProperty->SetIntPropertyValue(Value, IntValue);
+				return true;
+			}
+
+			UnderlyingProperty->SetIntPropertyValue(Value, TokenAsInteger(Notation));
+			return true;
+		}
+
+		// The streaming version of Flake_ImportNumeric.
+		bool ReadNumeric(const FNumericProperty* NumericProperty, void* Value, const EJsonNotation Notation)
+		{
+			if (NumericProperty->IsEnum() && Notation == EJsonNotation::String)
+			{
+				return ReadEnum(NumericProperty->GetIntPropertyEnum(), NumericProperty, Value, Notation);
+			}
+
+			if (NumericProperty->IsFloatingPoint())
+			{
+				NumericProperty->SetFloatingPointPropertyValue(Value, TokenAsNumber(Notation));
+				return true;
+			}
+
+			if (NumericProperty->IsInteger())
+			{
+				// Strings are parsed as int64 directly so they don't lose any precision going through a double.
+				NumericProperty->SetIntPropertyValue(Value, Notation == EJsonNotation::String ?
+					FCString::Atoi64(*Reader->GetValueAsString()) : TokenAsInteger(Notation));
+				return true;
+			}
+
+			return false;
+		}
+
+		// Reads an instanced struct, after the start of its object has been read.
+		bool ReadInstancedStruct(FStructProperty* StructProperty, FInstancedStruct& InstancedStruct)
+		{
+			EJsonNotation Notation;
+			if (!Reader->ReadNext(Notation))
+			{
+				return false;
+			}
+
+			// The exporter always writes the struct name first, so the struct can be made before reading its fields.
+			if (Notation == EJsonNotation::String && Reader->GetIdentifier() == ObjectStructNameKey)
+			{
+				const UScriptStruct* Struct = FindInstancedStructType(Reader->GetValueAsString(), StructProperty->Struct);
+				InstancedStruct.InitializeAs(Struct);
+				return ReadFields(Struct, InstancedStruct.GetMutableMemory(), nullptr);
+			}
+
+			// Empty instanced structs are written as an empty object.
+			if (Notation == EJsonNotation::ObjectEnd)
+			{
+				InstancedStruct.Reset();
+				return true;
+			}
+
+			const TSharedRef<FJsonObject> JsonObject = MakeShared<FJsonObject>();
+			if (!ParseFields(*JsonObject, Notation))
+			{
+				return false;
+			}
+			return JsonCustomImporter(MakeShared<FJsonValueObject>(JsonObject), StructProperty, &InstancedStruct, &CustomImporter, nullptr);
+		}
+
+		// Reads an object owned by the container, after the start of its object has been read.
+		bool ReadOwnedObject(const FObjectProperty* ObjectProperty, void* Value, UObject* Container)
+		{
+			UObject* Outer = Container ? Container : GetTransientPackage();
+
+			EJsonNotation Notation;
+			if (!Reader->ReadNext(Notation))
+			{
+				return false;
+			}
+
+			// The exporter always writes the class name first, so the object can be made before reading its fields.
+			if (Notation == EJsonNotation::String && Reader->GetIdentifier() == CopiedFromJsonObjectConverter::ObjectClassNameKey)
+			{
+				UClass* Class = FindObjectClass(Reader->GetValueAsString(), ObjectProperty->PropertyClass);
+				UObject* Object = NewObject<UObject>(Outer, Class);
+				ObjectProperty->SetObjectPropertyValue(Value, Object);
+				return ReadFields(Class, Object, Object);
+			}
+
+			const TSharedRef<FJsonObject> JsonObject = MakeShared<FJsonObject>();
+			if (!ParseFields(*JsonObject, Notation))
+			{
+				return false;
+			}
+
+			FString ClassString;
+			JsonObject->TryGetStringField(CopiedFromJsonObjectConverter::ObjectClassNameKey, ClassString);
+			JsonObject->RemoveField(CopiedFromJsonObjectConverter::ObjectClassNameKey);
+
+			UClass* Class = FindObjectClass(ClassString, ObjectProperty->PropertyClass);
+			UObject* Object = NewObject<UObject>(Outer, Class);
+			ObjectProperty->SetObjectPropertyValue(Value, Object);
+
+			constexpr bool bStrictMode = false;
+			return FJsonObjectConverter::JsonObjectToUStruct(JsonObject, Class, Object, CheckFlags, SkipFlags, bStrictMode, nullptr, &CustomImporter);
+		}
+
+		// The streaming version of JsonCustomImporter.
+		ECustomResult ReadCustom(FProperty* Property, void* Value, const EJsonNotation Notation)
+		{
+			if (FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+			{
+				const TSharedRef<const FStructInfo> StructInfo = GetStructInfo(StructProperty->Struct);
+
+				if (StructInfo->Kind == EStructKind::GameplayTag)
+				{
+					// Reading from the tag's string handles tag redirectors.
+					if (IsScalar(Notation))
+					{
+						static_cast<FGameplayTag*>(Value)->FromExportString(TokenAsString(Notation));
+						return ECustomResult::Read;
+					}
+				}
+				else if (StructInfo->Kind == EStructKind::InstancedStruct)
+				{
+					if (Notation == EJsonNotation::ObjectStart)
+					{
+						return ReadInstancedStruct(StructProperty, *static_cast<FInstancedStruct*>(Value)) ?
+							ECustomResult::Read : ECustomResult::Failed;
+					}
+				}
+				else if (StructInfo->Kind == EStructKind::NumericWrapper)
+				{
+					if (IsScalar(Notation))
+					{
+						return ReadNumeric(StructInfo->NumericProperty, Value, Notation) ? ECustomResult::Read : ECustomResult::Failed;
+					}
+				}
+				return ECustomResult::Unhandled;
+			}
+
+			if (const FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+			{
+				if (IsScalar(Notation))
+				{
+					return ReadEnum(EnumProperty->GetEnum(), EnumProperty->GetUnderlyingProperty(), Value, Notation) ?
+						ECustomResult::Read : ECustomResult::Failed;
+				}
+			}
+
+			return ECustomResult::Unhandled;
+		}
+
+		// The streaming version of ConvertScalarJsonValueToFPropertyWithContainer.
+		bool ReadValue(FProperty* Property, void* Value, const EJsonNotation Notation, UObject* Container)
+		{
+			switch (ReadCustom(Property, Value, Notation))
+			{
+			case ECustomResult::Read: return true;
+			case ECustomResult::Failed: return false;
+			default: break;
+			}
+
+			if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+			{
+				if (!IsScalar(Notation)) return MismatchedValue(Notation, TEXT("Number"));
+				return ReadNumeric(NumericProperty, Value, Notation);
+			}
+
+			if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+			{
+				if (!IsScalar(Notation)) return MismatchedValue(Notation, TEXT("Boolean"));
+				BoolProperty->SetPropertyValue(Value, TokenAsBool(Notation));
+				return true;
+			}
+
+			if (const FStrProperty* StringProperty = CastField<FStrProperty>(Property))
+			{
+				if (!IsScalar(Notation)) return MismatchedValue(Notation, TEXT("String"));
+				StringProperty->SetPropertyValue(Value, TokenAsString(Notation));
+				return true;
+			}
+
+			if (const FTextProperty* TextProperty = CastField<FTextProperty>(Property))
+			{
+				if (Notation == EJsonNotation::String)
+				{
+					// Matches EJsonObjectConversionFlags::WriteTextAsComplexString, falling back to invariant text.
+					const FString& TextString = Reader->GetValueAsString();
+					FText Text;
+					if (!FTextStringHelper::ReadFromBuffer(*TextString, Text))
+					{
+						Text = FText::FromString(TextString);
+					}
+					TextProperty->SetPropertyValue(Value, Text);
+					return true;
+				}
+
+				// Culture maps are rare enough to leave to the converter.
+				return ReadWithConverter(Property, Value, Notation);
+			}
+
+			if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+			{
+				if (Notation != EJsonNotation::ArrayStart)
+				{
+					UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Attempted to import TArray from non-array JSON key"));
+					return false;
+				}
+
+				FScriptArrayHelper Helper(ArrayProperty, Value);
+
+				if constexpr (CanReadBytes)
+				{
+					if (Reader->IsByteString() && IsPlainByteProperty(ArrayProperty->Inner))
+					{
+						const TConstArrayView<uint8> Bytes = Reader->ConsumeByteString();
+						Helper.Resize(Bytes.Num());
+						if (!Bytes.IsEmpty())
+						{
+							FMemory::Memcpy(Helper.GetRawPtr(), Bytes.GetData(), Bytes.Num());
+						}
+						return true;
+					}
+				}
+
+				// Like the converter, existing elements are written over rather than reset first.
+				int32 Index = 0;
+				EJsonNotation ElementNotation;
+				while (Reader->ReadNext(ElementNotation))
+				{
+					if (ElementNotation == EJsonNotation::ArrayEnd)
+					{
+						Helper.Resize(Index);
+						return true;
+					}
+
+					if (Index >= Helper.Num())
+					{
+						Helper.Resize(Index + 1);
+					}
+
+					if (ElementNotation != EJsonNotation::Null &&
+						!ReadProperty(ArrayProperty->Inner, Helper.GetRawPtr(Index), ElementNotation, Container))
+					{
+						UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to deserialize array element [%d] for property %s"), Index, *Property->GetAuthoredName());
+						return false;
+					}
+					++Index;
+				}
+				return false;
+			}
+
+			if (const FSetProperty* SetProperty = CastField<FSetProperty>(Property))
+			{
+				if (Notation != EJsonNotation::ArrayStart)
+				{
+					UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Attempted to import TSet from non-array JSON key"));
+					return false;
+				}
+
+				FScriptSetHelper Helper(SetProperty, Value);
+				Helper.EmptyElements();
+
+				bool Success = false;
+				EJsonNotation ElementNotation;
+				while (Reader->ReadNext(ElementNotation))
+				{
+					if (ElementNotation == EJsonNotation::ArrayEnd)
+					{
+						Success = true;
+						break;
+					}
+
+					if (ElementNotation == EJsonNotation::Null)
+					{
+						continue;
+					}
+
+					const int32 NewIndex = Helper.AddDefaultValue_Invalid_NeedsRehash();
+					if (!ReadProperty(SetProperty->ElementProp, Helper.GetElementPtr(NewIndex), ElementNotation, Container))
+					{
+						UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to deserialize set element [%d] for property %s"), NewIndex, *Property->GetAuthoredName());
+						break;
+					}
+				}
+
+				Helper.Rehash();
+				return Success;
+			}
+
+			if (const FMapProperty* MapProperty = CastField<FMapProperty>(Property))
+			{
+				if (Notation != EJsonNotation::ObjectStart)
+				{
+					UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Attempted to import TMap from non-object JSON key"));
+					return false;
+				}
+
+				FScriptMapHelper Helper(MapProperty, Value);
+				Helper.EmptyValues();
+
+				// Each key is read on its own first, so that repeated keys, which may differ only in case, replace the
+				// earlier value, as they would in an FJsonObject.
+				FProperty* KeyProperty = MapProperty->KeyProp;
+				void* Key = FMemory_Alloca_Aligned(KeyProperty->GetElementSize(), KeyProperty->GetMinAlignment());
+				KeyProperty->InitializeValue(Key);
+				ON_SCOPE_EXIT { KeyProperty->DestroyValue(Key); };
+
+				bool Success = false;
+				EJsonNotation ElementNotation;
+				while (Reader->ReadNext(ElementNotation))
+				{
+					if (ElementNotation == EJsonNotation::ObjectEnd)
+					{
+						Success = true;
+						break;
+					}
+
+					if (ElementNotation == EJsonNotation::Null)
+					{
+						continue;
+					}
+
+					const FString KeyString = Reader->GetIdentifier();
+					KeyProperty->ClearValue(Key);
+					if (!ReadKey(KeyProperty, Key, KeyString))
+					{
+						UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to deserialize map element [key: %s] for property %s"), *KeyString, *Property->GetAuthoredName());
+						break;
+					}
+
+					const int32 Index = Helper.FindOrAdd(Key);
+					MapProperty->ValueProp->ClearValue(Helper.GetValuePtr(Index));
+					if (!ReadProperty(MapProperty->ValueProp, Helper.GetValuePtr(Index), ElementNotation, Container))
+					{
+						UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to deserialize map element [key: %s] for property %s"), *KeyString, *Property->GetAuthoredName());
+						break;
+					}
+				}
+
+				return Success;
+			}
+
+			if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+			{
+				if (Notation == EJsonNotation::ObjectStart)
+				{
+					return ReadFields(StructProperty->Struct, Value, Container);
+				}
+
+				if (Notation == EJsonNotation::String)
+				{
+					const FString& ImportTextString = Reader->GetValueAsString();
+
+					// Like the converter, colors can be read from hex, and dates from ISO 8601.
+					if (StructProperty->Struct == TBaseStructure<FLinearColor>::Get())
+					{
+						*static_cast<FLinearColor*>(Value) = FColor::FromHex(ImportTextString);
+						return true;
+					}
+					if (StructProperty->Struct == TBaseStructure<FColor>::Get())
+					{
+						*static_cast<FColor*>(Value) = FColor::FromHex(ImportTextString);
+						return true;
+					}
+					if (StructProperty->Struct == TBaseStructure<FDateTime>::Get())
+					{
+						return ReadDateTime(ImportTextString, *static_cast<FDateTime*>(Value));
+					}
+
+					if (GetStructInfo(StructProperty->Struct)->HasImportTextItem)
+					{
+						const TCHAR* ImportTextPtr = *ImportTextString;
+						if (!StructProperty->Struct->GetCppStructOps()->ImportTextItem(ImportTextPtr, Value, PPF_None, nullptr, static_cast<FOutputDevice*>(GWarn)))
+						{
+							UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - ImportTextItem failed for property %s"), *Property->GetAuthoredName());
+							return false;
+						}
+						return true;
+					}
+					return ImportText(Property, Value, ImportTextString);
+				}
+
+				UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Attempted to import UStruct from non-object JSON key"));
+				return false;
+			}
+
+			if (const FObjectProperty* ObjectProperty = CastField<FObjectProperty>(Property))
+			{
+				if (Notation == EJsonNotation::ObjectStart)
+				{
+					return ReadOwnedObject(ObjectProperty, Value, Container);
+				}
+
+				if (Notation == EJsonNotation::String)
+				{
+					return ImportText(Property, Value, Reader->GetValueAsString());
+				}
+
+				// The converter leaves the reference alone for anything else.
+				return SkipValue(Notation);
+			}
+
+			// Everything else is imported from text.
+			if (!IsScalar(Notation)) return MismatchedValue(Notation, TEXT("String"));
+			return ImportText(Property, Value, TokenAsString(Notation));
+		}
+
+		// The same strings the converter accepts for dates.
+		static bool ReadDateTime(const FString& DateString, FDateTime& OutDateTime)
+		{
+			if (DateString == TEXT("min"))
+			{
+				OutDateTime = FDateTime::MinValue();
+			}
+			else if (DateString == TEXT("max"))
+			{
+				OutDateTime = FDateTime::MaxValue();
+			}
+			else if (DateString == TEXT("now"))
+			{
+				OutDateTime = FDateTime::UtcNow();
+			}
+			else if (!FDateTime::ParseIso8601(*DateString, OutDateTime) && !FDateTime::Parse(DateString, OutDateTime))
+			{
+				UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable to import FDateTime from string value %s"), *DateString);
+				return false;
+			}
+			return true;
+		}
+
+		// Map keys are always strings, so they go through the converter, which is cheap for the types keys can be.
+		bool ReadKey(FProperty* KeyProperty, void* Key, const FString& KeyString)
+		{
+			constexpr bool bStrictMode = false;
+			return FJsonObjectConverter::JsonValueToUProperty(MakeShared<FJsonValueString>(KeyString), KeyProperty, Key,
+				CheckFlags, SkipFlags, bStrictMode, nullptr, &CustomImporter);
+		}
+
+		// Parses the value on its own, and has the converter read it.
+		bool ReadWithConverter(FProperty* Property, void* Value, const EJsonNotation Notation)
+		{
+			const TSharedPtr<FJsonValue> JsonValue = ParseValue(Notation);
+			if (!JsonValue.IsValid())
+			{
+				return false;
+			}
+
+			constexpr bool bStrictMode = false;
+			return FJsonObjectConverter::JsonValueToUProperty(JsonValue, Property, Value,
+				CheckFlags, SkipFlags, bStrictMode, nullptr, &CustomImporter);
+		}
+
+		static bool ImportText(const FProperty* Property, void* Value, const FString& Text)
+		{
+			if (Property->ImportText_Direct(*Text, Value, nullptr, PPF_None) == nullptr)
+			{
+				UE_LOG(LogJson, Error, TEXT("JsonValueToUProperty - Unable import property type %s from string value for property %s"), *Property->GetClass()->GetName(), *Property->GetAuthoredName());
+				return false;
+			}
+			return true;
+		}
+
+		// Json values in the wrong shape are logged and left alone, as the converter would.
+		bool MismatchedValue(const EJsonNotation Notation, const TCHAR* Type)
+		{
+			UE_LOG(LogJson, Error, TEXT("Json Value of type '%s' used as a '%s'."),
+				Notation == EJsonNotation::ObjectStart ? TEXT("Object") : Notation == EJsonNotation::ArrayStart ? TEXT("Array") : TEXT("Null"), Type);
+			return SkipValue(Notation);
+		}
+
+		// These convert scalar tokens the same way FJsonValue's AsString, AsNumber, and AsBool do.
+		FString TokenAsString(const EJsonNotation Notation) const
+		{
+			switch (Notation)
+			{
+			case EJsonNotation::String: return Reader->GetValueAsString();
+			case EJsonNotation::Number: return FString::SanitizeFloat(Reader->GetValueAsNumber(), 0);
+			case EJsonNotation::Boolean: return Reader->GetValueAsBoolean() ? TEXT("true") : TEXT("false");
+			default: return FString();
+			}
+		}
+
+		double TokenAsNumber(const EJsonNotation Notation) const
+		{
+			switch (Notation)
+			{
+			case EJsonNotation::Number: return Reader->GetValueAsNumber();
+			case EJsonNotation::Boolean: return Reader->GetValueAsBoolean() ? 1.0 : 0.0;
+			case EJsonNotation::String:
+				{
+					double Number = 0.0;
+					LexTryParseString(Number, *Reader->GetValueAsString());
+					return Number;
+				}
+			default: return 0.0;
+			}
+		}
+
+		int64 TokenAsInteger(const EJsonNotation Notation) const
+		{
+			if constexpr (CanReadIntegers)
+			{
+				if (Notation == EJsonNotation::Number)
+				{
+					return Reader->GetValueAsInteger();
+				}
+			}
+			return static_cast<int64>(TokenAsNumber(Notation));
+		}
+
+		bool TokenAsBool(const EJsonNotation Notation) const
+		{
+			switch (Notation)
+			{
+			case EJsonNotation::Boolean: return Reader->GetValueAsBoolean();
+			case EJsonNotation::Number: return Reader->GetValueAsNumber() != 0.0;
+			case EJsonNotation::String: return Reader->GetValueAsString().ToBool();
+			default: return false;
+			}
+		}
+
+		// Reads past the current value, including everything inside it.
+		bool SkipValue(const EJsonNotation Notation)
+		{
+			if (Notation == EJsonNotation::Error)
+			{
+				return false;
+			}
+
+			int32 Depth = Notation == EJsonNotation::ObjectStart || Notation == EJsonNotation::ArrayStart ? 1 : 0;
+			EJsonNotation Next;
+			while (Depth > 0 && Reader->ReadNext(Next))
+			{
+				if (Next == EJsonNotation::ObjectStart || Next == EJsonNotation::ArrayStart)
+				{
+					++Depth;
+				}
+				else if (Next == EJsonNotation::ObjectEnd || Next == EJsonNotation::ArrayEnd)
+				{
+					--Depth;
+				}
+			}
+			return Depth == 0;
+		}
+
+		// Parses the current value into json values, for the cases that can't be streamed.
+		TSharedPtr<FJsonValue> ParseValue(const EJsonNotation Notation)
+		{
+			switch (Notation)
+			{
+			case EJsonNotation::String: return MakeShared<FJsonValueString>(Reader->GetValueAsString());
+			case EJsonNotation::Number: return MakeShared<FJsonValueNumber>(Reader->GetValueAsNumber());
+			case EJsonNotation::Boolean: return MakeShared<FJsonValueBoolean>(Reader->GetValueAsBoolean());
+			case EJsonNotation::Null: return MakeShared<FJsonValueNull>();
+			case EJsonNotation::ObjectStart:
+				{
+					const TSharedRef<FJsonObject> JsonObject = MakeShared<FJsonObject>();
+					if (!ParseFields(*JsonObject)) return nullptr;
+					return MakeShared<FJsonValueObject>(JsonObject);
+				}
+			case EJsonNotation::ArrayStart:
+				{
+					TArray<TSharedPtr<FJsonValue>> Values;
+					EJsonNotation ElementNotation;
+					while (Reader->ReadNext(ElementNotation))
+					{
+						if (ElementNotation == EJsonNotation::ArrayEnd)
+						{
+							return MakeShared<FJsonValueArray>(Values);
+						}
+
+						TSharedPtr<FJsonValue> Element = ParseValue(ElementNotation);
+						if (!Element.IsValid()) return nullptr;
+						Values.Add(Element);
+					}
+					return nullptr;
+				}
+			default: return nullptr;
+			}
+		}
+
+		// Parses the rest of an object, starting with a field that has already been read.
+		bool ParseFields(FJsonObject& JsonObject, EJsonNotation Notation)
+		{
+			while (Notation != EJsonNotation::ObjectEnd)
+			{
+				const FString Identifier = Reader->GetIdentifier();
+				const TSharedPtr<FJsonValue> Value = ParseValue(Notation);
+				if (!Value.IsValid())
+				{
+					return false;
+				}
+				JsonObject.SetField(Identifier, Value);
+
+				if (!Reader->ReadNext(Notation))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool ParseFields(FJsonObject& JsonObject)
+		{
+			EJsonNotation Notation;
+			return Reader->ReadNext(Notation) && ParseFields(JsonObject, Notation);
+		}
+
+		TSharedRef<FReader> Reader;
+		FJsonObjectConverter::CustomImportCallback CustomImporter;
+	};
+}
\ No newline at end of file
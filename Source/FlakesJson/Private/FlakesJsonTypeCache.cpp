@@ -0,0 +1,150 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#include "FlakesJsonTypeCache.h"
+#include "FlakesTypeCache.h"
+#include "GameplayTagContainer.h"
+#include "JsonObjectWrapper.h"
+#include "StructUtils/InstancedStruct.h"
+
+namespace Flakes::Json
+{
+	namespace Private
+	{
+		// Is this struct equal to or a child with the same memory layout of a struct.
+		template <typename T>
+		bool IsStructCompatWith(const UScriptStruct* Struct)
+		{
+			static const UScriptStruct* const BaseStruct = TBaseStructure<T>::Get();
+
+			return Struct->IsChildOf(BaseStruct) &&
+				   Struct->GetPropertiesSize() == BaseStruct->GetPropertiesSize();
+		}
+
+		// Is this struct a wrapper over a simple numeric type
+		const FNumericProperty* FindNumericWrapperProperty(const UScriptStruct* Struct)
+		{
+			// DateTime already has custom export in JsonObjectConverter, skip this case.
+			if (IsStructCompatWith<FDateTime>(Struct)) return nullptr;
+
+			const FProperty* FirstProperty = nullptr;
+			for (TFieldIterator<FProperty> It(Struct); It; ++It)
+			{
+				if (FirstProperty)
+				{
+					// If we continue iterating, we have hit a second property, and can exit.
+					return nullptr;
+				}
+				FirstProperty = *It;
+			}
+
+			if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(FirstProperty);
+				NumericProperty && !NumericProperty->IsEnum())
+			{
+				return NumericProperty;
+			}
+
+			return nullptr;
+		}
+
+		TSharedRef<const FStructInfo> MakeStructInfo(const UStruct* Struct)
+		{
+			TSharedRef<FStructInfo> Info = MakeShared<FStructInfo>();
+
+			if (const UScriptStruct* ScriptStruct = Cast<UScriptStruct>(Struct))
+			{
+				if (ScriptStruct == FJsonObjectWrapper::StaticStruct())
+				{
+					Info->Kind = EStructKind::JsonObjectWrapper;
+				}
+				else if (IsStructCompatWith<FGameplayTag>(ScriptStruct))
+				{
+					Info->Kind = EStructKind::GameplayTag;
+				}
+				else if (IsStructCompatWith<FInstancedStruct>(ScriptStruct))
+				{
+					Info->Kind = EStructKind::InstancedStruct;
+				}
+				else if (const FNumericProperty* NumericProperty = FindNumericWrapperProperty(ScriptStruct))
+				{
+					Info->Kind = EStructKind::NumericWrapper;
+					Info->NumericProperty = NumericProperty;
+				}
+
+				if (const UScriptStruct::ICppStructOps* StructOps = ScriptStruct->GetCppStructOps())
+				{
+					Info->HasExportTextItem = StructOps->HasExportTextItem();
+					Info->HasImportTextItem = StructOps->HasImportTextItem();
+				}
+			}
+
+			for (TFieldIterator<FProperty> It(Struct); It; ++It)
+			{
+				// With no skip flags, the converter skips these by default when reading.
+				if (!It->HasAnyPropertyFlags(CPF_Deprecated))
+				{
+					Info->Properties.Add(It->GetName(), *It);
+					if (!Info->Properties.Contains(It->GetAuthoredName()))
+					{
+						Info->Properties.Add(It->GetAuthoredName(), *It);
+					}
+				}
+			}
+
+			return Info;
+		}
+
+		struct FEnumInfo
+		{
+			// Full, short, and authored names, matched case-insensitively like FNames are.
+			TMap<FString, int64> Values;
+		};
+
+		TSharedRef<const FEnumInfo> MakeEnumInfo(const UEnum* Enum)
+		{
+			TSharedRef<FEnumInfo> Info = MakeShared<FEnumInfo>();
+
+			auto AddName = [&Info](const FString& Name, const int64 Value)
+				{
+					if (!Name.IsEmpty() && !Info->Values.Contains(Name))
+					{
+						Info->Values.Add(Name, Value);
+					}
+				};
+
+			for (int32 Index = 0; Index < Enum->NumEnums(); ++Index)
+			{
+				const int64 Value = Enum->GetValueByIndex(Index);
+				AddName(Enum->GetNameByIndex(Index).ToString(), Value);
+				AddName(Enum->GetNameStringByIndex(Index), Value);
+				AddName(Enum->GetAuthoredNameStringByIndex(Index), Value);
+			}
+
+			return Info;
+		}
+
+		TTypeCache<UStruct, FStructInfo> Structs;
+		TTypeCache<UEnum, FEnumInfo> Enums;
+
+		TSharedRef<const FEnumInfo> GetEnumInfo(const UEnum* Enum)
+		{
+			return Enums.FindOrBuild(Enum, &MakeEnumInfo);
+		}
+	}
+
+	TSharedRef<const FStructInfo> GetStructInfo(const UStruct* Struct)
+	{
+		return Private::Structs.FindOrBuild(Struct, &Private::MakeStructInfo);
+	}
+
+	int64 GetEnumValueFromString(const UEnum* Enum, const FString& String)
+	{
+		check(Enum);
+
+		if (const int64* Value = Private::GetEnumInfo(Enum)->Values.Find(String))
+		{
+			return *Value;
+		}
+
+		return Enum->GetValueOrBitfieldFromString(String, EGetByNameFlags::CheckAuthoredName);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "UObject/Class.h"
+
+namespace Flakes::Json
+{
+	// The special cases the json rules have for struct types.
+	enum class EStructKind : uint8
+	{
+		Default,
+		GameplayTag,
+		InstancedStruct,
+
+		// Structs that only wrap a single number, which are written as the number itself.
+		NumericWrapper,
+
+		// Wrapped json, which is copied in and out as is.
+		JsonObjectWrapper
+	};
+
+	// What the json rules need to know about a struct, or class, worked out once per type.
+	struct FStructInfo
+	{
+		EStructKind Kind = EStructKind::Default;
+
+		// The property of a numeric wrapper.
+		const FNumericProperty* NumericProperty = nullptr;
+
+		bool HasExportTextItem = false;
+		bool HasImportTextItem = false;
+
+		// Properties by name, and by authored name, matched case-insensitively like json keys are.
+		TMap<FString, FProperty*> Properties;
+	};
+
+	// Gets the cached info for a struct. This is safe to call from any thread.
+	TSharedRef<const FStructInfo> GetStructInfo(const UStruct* Struct);
+
+	// A cached version of UEnum::GetValueOrBitfieldFromString with CheckAuthoredName. Names are found in a hash map,
+	// and anything else, such as bitfields and redirected names, falls back to the enum itself.
+	int64 GetEnumValueFromString(const UEnum* Enum, const FString& String);
+}
\ No newline at end of file
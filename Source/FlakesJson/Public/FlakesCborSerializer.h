@@ -0,0 +1,22 @@
+﻿// Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
+
+#pragma once
+
+#include "FlakesInterface.h"
+
+namespace Flakes::Cbor
+{
+	/*
+	 * A binary form of the Json provider. The same rules decide what is written, and the data has the same
+	 * self-describing structure, but it's encoded as CBOR (RFC 8949), so numbers and byte arrays are stored natively
+	 * instead of as text.
+	 */
+	SERIALIZATION_PROVIDER_HEADER(FLAKESJSON_API, Cbor, Type)
+
+	// Converts a Json or PrettyJson flake into a Cbor flake. The type of the flake doesn't need to be loaded. Flakes
+	// from before the provider was stored are accepted, if their payload is Json.
+	FLAKESJSON_API bool ConvertFromJson(const FFlake& JsonFlake, FFlake& OutCborFlake, const FReadOptions& Options = {});
+
+	// Converts a Cbor flake into a Json, or PrettyJson, flake. The type of the flake doesn't need to be loaded.
+	FLAKESJSON_API bool ConvertToJson(const FFlake& CborFlake, FFlake& OutJsonFlake, bool Pretty = false, const FReadOptions& Options = {});
+}
\ No newline at end of file
@@ -10,8 +10,8 @@
 
 namespace Flakes::Json
 {
-	SERIALIZATION_PROVIDER_HEADER(FLAKESJSON_API, Json, Regular)
-	SERIALIZATION_PROVIDER_HEADER(FLAKESJSON_API, PrettyJson, Pretty)
+	TEXT_SERIALIZATION_PROVIDER_HEADER(FLAKESJSON_API, Json, Regular)
+	TEXT_SERIALIZATION_PROVIDER_HEADER(FLAKESJSON_API, PrettyJson, Pretty)
 }
 
 UCLASS()
@@ -20,6 +20,7 @@ public class FlakesTests : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"FlakesJson",
 				"GameplayTags",
 			});
 	}
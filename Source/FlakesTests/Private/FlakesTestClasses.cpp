@@ -65,6 +65,11 @@ bool UFlakesTestSimpleObject::Equals(const UFlakesTestSimpleObject* TestObject2,
 	{
 		return false;
 	}
+	if (TestFloatArray != TestObject2->TestFloatArray)
+	{
+		Result = TEXT("Float Array Mismatch");
+		return false;
+	}
 	return true;
 }
 
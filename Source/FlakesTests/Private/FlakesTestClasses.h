@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "Engine/DataTable.h"
 #include "GameplayTagContainer.h"
 #include "GameplayTagsSettings.h"
 #include "NativeGameplayTags.h"
@@ -64,6 +65,146 @@ struct FFlakesTestCompoundStruct
 	bool Equals(const FFlakesTestCompoundStruct& Other, FString& Result) const;
 };
 
+// Two arrays that only differ in their inner type, to check that layout changes in array elements are detected.
+USTRUCT()
+struct FFlakesTestFloatArrayStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<float> Values;
+};
+
+USTRUCT()
+struct FFlakesTestIntArrayStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<int32> Values;
+};
+
+// Two plain-old-data structs with the same property names and sizes, but with their types swapped.
+USTRUCT()
+struct FFlakesTestPodStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 First = 0;
+
+	UPROPERTY()
+	float Second = 0.f;
+};
+
+USTRUCT()
+struct FFlakesTestRetypedPodStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	float First = 0.f;
+
+	UPROPERTY()
+	int32 Second = 0;
+};
+
+// A native struct with a vtable in front of its properties.
+USTRUCT()
+struct FFlakesTestTableRow : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Value = 0;
+
+	UPROPERTY()
+	float Scale = 0.f;
+};
+
+// A native struct with a member that isn't a property, which must never be copied.
+USTRUCT()
+struct FFlakesTestCacheStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Value = 0;
+
+	TArray<int32> Cache;
+};
+
+USTRUCT()
+struct FFlakesTestNestedCacheStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FFlakesTestCacheStruct Inner;
+
+	UPROPERTY()
+	TArray<FFlakesTestCacheStruct> Elements;
+};
+
+USTRUCT()
+struct FFlakesTestMapStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TMap<FName, int32> Names;
+};
+
+USTRUCT()
+struct FFlakesTestTextStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FString String;
+
+	UPROPERTY()
+	FText Text;
+};
+
+// Types the json rules read from strings.
+USTRUCT()
+struct FFlakesTestJsonStringsStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FColor Color = FColor::Black;
+
+	UPROPERTY()
+	FLinearColor LinearColor = FLinearColor::Black;
+
+	UPROPERTY()
+	FDateTime Date;
+};
+
+// Values Cbor stores natively, and properties json has to write a type name for.
+USTRUCT()
+struct FFlakesTestCborStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int64 BigInteger = 0;
+
+	UPROPERTY()
+	float Number = 0.f;
+
+	UPROPERTY()
+	TArray<uint8> Bytes;
+
+	UPROPERTY()
+	FInstancedStruct Instanced;
+
+	UPROPERTY()
+	TObjectPtr<UObject> Object;
+};
+
 /**
  *
  */
@@ -85,6 +226,9 @@ public:
 	UPROPERTY()
 	FFlakesTestCompoundStruct TestStruct;
 
+	UPROPERTY()
+	TArray<float> TestFloatArray;
+
 	static UFlakesTestSimpleObject* New(UObject* Outer = (UObject*)GetTransientPackage())
 	{
 		UFlakesTestSimpleObject* SimpleObject = NewObject<UFlakesTestSimpleObject>(Outer);
@@ -92,12 +236,36 @@ public:
 		SimpleObject->TestVector = FMath::VRand() * FMath::Rand();
 		SimpleObject->TestWrapper = FFlakesTestWrapperStruct::Rand();
 		SimpleObject->TestStruct = FFlakesTestCompoundStruct::Rand();
+		for (int32 i = 0; i < 64; ++i)
+		{
+			SimpleObject->TestFloatArray.Add(FMath::FRand() * FMath::Rand());
+		}
 		return SimpleObject;
 	}
 
 	bool Equals(const UFlakesTestSimpleObject* TestObject2, FString& Result) const;
 };
 
+// An owned object, held by a struct member instead of the object itself.
+USTRUCT()
+struct FFlakesTestObjectHolder
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<UFlakesTestSimpleObject> Object;
+};
+
+UCLASS()
+class UFlakesTestHolderObject : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	FFlakesTestObjectHolder Holder;
+};
+
 /**
  *
  */
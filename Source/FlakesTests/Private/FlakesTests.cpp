@@ -1,9 +1,18 @@
 // Copyright Guy (Drakynfly) Lundvall. All Rights Reserved.
 
 #include "FlakesModule.h"
+#include "FlakesCborSerializer.h"
 #include "FlakesInterface.h"
+#include "FlakesLazy.h"
+#include "FlakesMemory.h"
+#include "FlakesSerializationPlan.h"
 #include "FlakesTestClasses.h"
+#include "Compression/OodleDataCompressionUtil.h"
+#include "HAL/IConsoleManager.h"
 #include "Misc/AutomationTest.h"
+#include "Providers/FlakesBinarySerializer.h"
+#include "Providers/FlakesFastBinarySerializer.h"
+#include "UObject/StrongObjectPtr.h"
 
 IMPLEMENT_COMPLEX_AUTOMATION_TEST(FlakesTests,
 								 "Flakes.ToFromTests",
@@ -21,6 +30,10 @@ void FlakesTests::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>&
 		// Add test without compression
 		OutBeautifiedNames.Add(Provider.ToString() + TEXT("Raw"));
 		OutTestCommands.Add(Provider.ToString() + TEXT(" -nocompress"));
+
+		// Add test with adaptive compression
+		OutBeautifiedNames.Add(Provider.ToString() + TEXT("Adaptive"));
+		OutTestCommands.Add(Provider.ToString() + TEXT(" -adaptive"));
 	}
 }
 
@@ -37,6 +50,7 @@ bool FlakesTests::RunTest(const FString& Parameters)
 	// Extract the compression setting
 	bool DisableCompression = false;
 	FParse::Bool(*Parameters, TEXT("nocompress"), DisableCompression);
+	const bool AdaptiveCompression = FParse::Param(*Parameters, TEXT("adaptive"));
 
 	Flakes::FReadOptions ReadOps;
 	Flakes::FWriteOptions WriteOps;
@@ -47,6 +61,11 @@ bool FlakesTests::RunTest(const FString& Parameters)
 		WriteOps.SkipDecompressionStep = true;
 	}
 
+	if (AdaptiveCompression)
+	{
+		ReadOps.AdaptiveCompression = true;
+	}
+
 	{
 		const FVector TestVector(FMath::VRand() * FMath::Rand());
 		const FFlake FlakeFromVector = Flakes::MakeFlake(Backend, FConstStructView::Make(TestVector), nullptr, ReadOps);
@@ -121,7 +140,6 @@ bool FlakesTests::RunTest(const FString& Parameters)
 	{
 		UFlakesTestComplexObject* TestObject3 = NewObject<UFlakesTestComplexObject>();
 		TestObject3->ObjOwnedByUs = UFlakesTestSimpleObject::New(TestObject3);
-		//TestObject3->TestSimpleObjectArray.Add(TestObject3->ObjOwnedByUs); // @todo multiple references to own object
 		for (int32 i = 0; i < 10; ++i)
 		{
 			TestObject3->TestSimpleObjectArray.Add(UFlakesTestSimpleObject::New(TestObject3));
@@ -141,18 +159,1104 @@ bool FlakesTests::RunTest(const FString& Parameters)
 			AddInfo(Error);
 		}
 
-		// @todo multiple references to own object
-		/*
-		if (!TestTrue("TestValueBack_ComplexObject_2", TestObject4->ObjOwnedByUs == TestObject4->TestSimpleObjectArray[0]))
+		AddInfo(TEXT("Complex Object Size: ") + LexToString(FlakeFromObject.Data.NumBytes()));
+	}
+
+	// Multiple references to our own object are only restored by the binary providers' object table.
+	if (Backend == FName("Binary") || Backend == FName("NetBinary"))
+	{
+		UFlakesTestComplexObject* TestObject5 = NewObject<UFlakesTestComplexObject>();
+		TestObject5->ObjOwnedByUs = UFlakesTestSimpleObject::New(TestObject5);
+		TestObject5->TestSimpleObjectArray.Add(TestObject5->ObjOwnedByUs);
+		TestObject5->TestSimpleObjectArray.Add(nullptr);
+		TestObject5->TestSimpleObjectArray.Add(UFlakesTestSimpleObject::New(TestObject5));
+
+		const FFlake FlakeFromObject = Flakes::MakeFlake(Backend, TestObject5, ReadOps);
+
+		UFlakesTestComplexObject* TestObject6 = Flakes::CreateObject<UFlakesTestComplexObject>(Backend, FlakeFromObject, GetTransientPackage(), WriteOps);
+
+		if (TestNotNull("TestValueBack_SharedReference", TestObject6) &&
+			TestEqual("TestValueBack_SharedReference_Num", TestObject6->TestSimpleObjectArray.Num(), 3))
 		{
-			AddInfo(TEXT("ObjOwnedByUs = ") + (TestObject4->ObjOwnedByUs ? TestObject4->ObjOwnedByUs->GetFullName() : "NULL"));
-			AddInfo(TEXT("TestSimpleObjectArray[0] = ") + (TestObject4->TestSimpleObjectArray[0] ? TestObject4->TestSimpleObjectArray[0]->GetFullName() : "NULL"));
+			if (!TestTrue("TestValueBack_SharedReference_Same", TestObject6->ObjOwnedByUs == TestObject6->TestSimpleObjectArray[0]))
+			{
+				AddInfo(TEXT("ObjOwnedByUs = ") + (TestObject6->ObjOwnedByUs ? TestObject6->ObjOwnedByUs->GetFullName() : "NULL"));
+				AddInfo(TEXT("TestSimpleObjectArray[0] = ") + (TestObject6->TestSimpleObjectArray[0] ? TestObject6->TestSimpleObjectArray[0]->GetFullName() : "NULL"));
+			}
+
+			TestNull("TestValueBack_SharedReference_Null", TestObject6->TestSimpleObjectArray[1].Get());
+			TestTrue("TestValueBack_SharedReference_Outer", TestObject6->ObjOwnedByUs && TestObject6->ObjOwnedByUs->GetOuter() == TestObject6);
 		}
-		*/
 
-		AddInfo(TEXT("Complex Object Size: ") + LexToString(FlakeFromObject.Data.NumBytes()));
+		AddInfo(TEXT("Shared Reference Object Size: ") + LexToString(FlakeFromObject.Data.NumBytes()));
 	}
 
 	// All tests passed.
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesExportScalingTest,
+								 "Flakes.Perf.ExportScaling",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FlakesExportScalingTest::RunTest(const FString& Parameters)
+{
+	// Makes flakes from objects with an increasing number of subobjects. Every subobject must be exported, and read back
+	// into the new object. The timings are only reported, as they're too noisy to assert on.
+	const FName Backend = FName("Binary");
+
+	for (const int32 NumSubobjects : { 1000, 10000, 100000 })
+	{
+		UFlakesTestComplexObject* TestObject = NewObject<UFlakesTestComplexObject>();
+		TestObject->TestSimpleObjectArray.Reserve(NumSubobjects);
+		for (int32 i = 0; i < NumSubobjects; ++i)
+		{
+			TestObject->TestSimpleObjectArray.Add(NewObject<UFlakesTestSimpleObject>(TestObject));
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		const FFlake Flake = Flakes::MakeFlake(Backend, TestObject);
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+		AddInfo(FString::Printf(TEXT("%d subobjects: %.2fms, %lld bytes"), NumSubobjects, Seconds * 1000.0, Flake.Data.NumBytes()));
+
+		UFlakesTestComplexObject* TestObject2 = Flakes::CreateObject<UFlakesTestComplexObject>(Backend, Flake);
+		if (TestNotNull(TEXT("Object created"), TestObject2) &&
+			TestEqual(FString::Printf(TEXT("All %d subobjects exported"), NumSubobjects), TestObject2->TestSimpleObjectArray.Num(), NumSubobjects))
+		{
+			int32 NumOwned = 0;
+			for (const UFlakesTestSimpleObject* Subobject : TestObject2->TestSimpleObjectArray)
+			{
+				NumOwned += Subobject && Subobject->GetOuter() == TestObject2;
+			}
+			TestEqual(FString::Printf(TEXT("All %d subobjects are outered to the new object"), NumSubobjects), NumOwned, NumSubobjects);
+
+			TestObject2->MarkAsGarbage();
+		}
+
+		TestObject->MarkAsGarbage();
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesFastBinaryTest,
+								 "Flakes.Perf.FastBinary",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FlakesFastBinaryTest::RunTest(const FString& Parameters)
+{
+	// Time to repeatedly serialize the same struct type, with the compiled plan against SerializeItem.
+	constexpr int32 Iterations = 100000;
+	const FFlakesTestCompoundStruct TestStruct = FFlakesTestCompoundStruct::Rand();
+	const FConstStructView View = FConstStructView::Make(TestStruct);
+
+	auto Time = [&](auto&& ReadData)
+		{
+			TArray<uint8> Bytes;
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 i = 0; i < Iterations; ++i)
+			{
+				Bytes.Reset();
+				ReadData(View, Bytes, nullptr);
+			}
+			return FPlatformTime::Seconds() - StartTime;
+		};
+
+	const double BinarySeconds = Time([](const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer)
+		{
+			Flakes::Binary::Type::ReadData(Struct, OutData, Outer);
+		});
+	const double FastBinarySeconds = Time([](const FConstStructView& Struct, TArray<uint8>& OutData, const UObject* Outer)
+		{
+			Flakes::FastBinary::Type::ReadData(Struct, OutData, Outer);
+		});
+
+	// Only reported, as timings are too noisy to assert on.
+	AddInfo(FString::Printf(TEXT("Binary: %.2fms, FastBinary: %.2fms"), BinarySeconds * 1000.0, FastBinarySeconds * 1000.0));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesLayoutHashTest,
+								 "Flakes.LayoutHash",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesLayoutHashTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("FastBinary");
+
+	// Same property names, offsets, and sizes, so only the element type tells these apart.
+	TestNotEqual(TEXT("Array element type is part of the layout"),
+		Flakes::Plan::GetPlan(FFlakesTestFloatArrayStruct::StaticStruct())->LayoutHash,
+		Flakes::Plan::GetPlan(FFlakesTestIntArrayStruct::StaticStruct())->LayoutHash);
+
+	FFlakesTestFloatArrayStruct FloatArray;
+	FloatArray.Values = { 1.f, 2.f, 3.f };
+	const FFlake Flake = Flakes::MakeFlake(Backend, FConstStructView::Make(FloatArray));
+
+	FFlakesTestFloatArrayStruct FloatArray2;
+	Flakes::WriteStruct(Backend, FStructView::Make(FloatArray2), Flake);
+	TestEqual(TEXT("TestValueBack_FastBinaryArray"), FloatArray2.Values, FloatArray.Values);
+
+	// Reading the floats back as ints must fail, rather than reinterpret their bits.
+	AddExpectedError(TEXT("different layout"), EAutomationExpectedErrorFlags::Contains, 1);
+	AddExpectedError(TEXT("failed to serialized struct"), EAutomationExpectedErrorFlags::Contains, 1);
+	FFlakesTestIntArrayStruct IntArray;
+	Flakes::WriteStruct(Backend, FStructView::Make(IntArray), Flake);
+	TestTrue(TEXT("Mismatched layout is not read"), IntArray.Values.IsEmpty());
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesNestedStructsTest,
+								 "Flakes.NestedStructs",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesNestedStructsTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("FastBinary");
+
+	FFlakesTestNestedCacheStruct TestStruct;
+	TestStruct.Inner.Value = 1;
+	TestStruct.Inner.Cache = { 1, 2 };
+	for (int32 Index = 0; Index < 3; ++Index)
+	{
+		FFlakesTestCacheStruct& Element = TestStruct.Elements.AddDefaulted_GetRef();
+		Element.Value = Index + 2;
+		Element.Cache = { Index };
+	}
+
+	// Nested native structs with members that aren't properties must not be copied as whole elements, which would
+	// share the arrays that aren't properties between the source, and what is read back.
+	const TSharedRef<const Flakes::Plan::FPlan> Plan = Flakes::Plan::GetPlan(FFlakesTestNestedCacheStruct::StaticStruct());
+	TestFalse(TEXT("Struct is not a single memcpy"), Plan->IsPod);
+	for (const Flakes::Plan::FOp& Op : Plan->Ops)
+	{
+		if (Op.Op == Flakes::Plan::EOp::Array)
+		{
+			TestFalse(TEXT("Array elements are not copied as a block"), Op.Element->IsPod);
+		}
+	}
+
+	const FFlake Flake = Flakes::MakeFlake(Backend, FConstStructView::Make(TestStruct));
+
+	FFlakesTestNestedCacheStruct TestStruct2;
+	TestStruct2.Inner.Cache = { 5 };
+	Flakes::WriteStruct(Backend, FStructView::Make(TestStruct2), Flake);
+
+	TestEqual(TEXT("TestValueBack_Inner"), TestStruct2.Inner.Value, TestStruct.Inner.Value);
+	TestEqual(TEXT("Nested member that isn't a property is left alone"), TestStruct2.Inner.Cache, TArray<int32>{ 5 });
+	if (TestEqual(TEXT("TestValueBack_ElementsNum"), TestStruct2.Elements.Num(), TestStruct.Elements.Num()))
+	{
+		for (int32 Index = 0; Index < TestStruct2.Elements.Num(); ++Index)
+		{
+			TestEqual(TEXT("TestValueBack_Element"), TestStruct2.Elements[Index].Value, TestStruct.Elements[Index].Value);
+			TestTrue(TEXT("Element member that isn't a property is not copied"), TestStruct2.Elements[Index].Cache.IsEmpty());
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesPodTest,
+								 "Flakes.Pod",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesPodTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Pod");
+
+	// Keep the payloads raw, so the mode byte can be checked.
+	Flakes::FReadOptions ReadOps;
+	ReadOps.CompressionLevel = FOodleDataCompression::ECompressionLevel::None;
+
+	FFlakesTestPodStruct PodStruct;
+	PodStruct.First = 42;
+	PodStruct.Second = 3.5f;
+	const FFlake PodFlake = Flakes::MakeFlake(Backend, FConstStructView::Make(PodStruct), nullptr, ReadOps);
+
+	FFlakesTestFloatArrayStruct FlatStruct;
+	FlatStruct.Values = { 1.f, 2.f, 3.f };
+	const FFlake FlatFlake = Flakes::MakeFlake(Backend, FConstStructView::Make(FlatStruct), nullptr, ReadOps);
+
+	const FFlakesTestCompoundStruct CompoundStruct = FFlakesTestCompoundStruct::Rand();
+	const FFlake CompoundFlake = Flakes::MakeFlake(Backend, FConstStructView::Make(CompoundStruct), nullptr, ReadOps);
+
+	// The first byte of a Pod payload is the mode it was written with.
+	if (TestFalse(TEXT("Payloads are not empty"), PodFlake.Data.IsEmpty() || FlatFlake.Data.IsEmpty() || CompoundFlake.Data.IsEmpty()))
+	{
+		TestEqual(TEXT("Plain-old-data struct is copied as is"), static_cast<int32>(PodFlake.Data[0]), 0);
+		TestEqual(TEXT("Struct with a float array is flat"), static_cast<int32>(FlatFlake.Data[0]), 1);
+		TestEqual(TEXT("Struct with names and native serialization falls back to FastBinary"), static_cast<int32>(CompoundFlake.Data[0]), 2);
+	}
+
+	// Native structs with members that aren't properties are written a property at a time, so those members are left
+	// alone when reading back.
+	FFlakesTestTableRow Row;
+	Row.Value = 7;
+	Row.Scale = 0.5f;
+	const FFlake RowFlake = Flakes::MakeFlake(Backend, FConstStructView::Make(Row), nullptr, ReadOps);
+
+	FFlakesTestCacheStruct CacheStruct;
+	CacheStruct.Value = 9;
+	CacheStruct.Cache = { 1, 2, 3 };
+	const FFlake CacheFlake = Flakes::MakeFlake(Backend, FConstStructView::Make(CacheStruct), nullptr, ReadOps);
+
+	if (TestFalse(TEXT("Payloads are not empty"), RowFlake.Data.IsEmpty() || CacheFlake.Data.IsEmpty()))
+	{
+		TestEqual(TEXT("Struct with a vtable is flat"), static_cast<int32>(RowFlake.Data[0]), 1);
+		TestEqual(TEXT("Struct with a member that isn't a property is flat"), static_cast<int32>(CacheFlake.Data[0]), 1);
+	}
+
+	FFlakesTestTableRow Row2;
+	Flakes::WriteStruct(Backend, FStructView::Make(Row2), RowFlake);
+	TestEqual(TEXT("TestValueBack_RowValue"), Row2.Value, Row.Value);
+	TestEqual(TEXT("TestValueBack_RowScale"), Row2.Scale, Row.Scale);
+
+	FFlakesTestCacheStruct CacheStruct2;
+	CacheStruct2.Cache = { 4 };
+	Flakes::WriteStruct(Backend, FStructView::Make(CacheStruct2), CacheFlake);
+	TestEqual(TEXT("TestValueBack_CacheValue"), CacheStruct2.Value, CacheStruct.Value);
+	TestEqual(TEXT("Member that isn't a property is left alone"), CacheStruct2.Cache, TArray<int32>{ 4 });
+
+	FFlakesTestPodStruct PodStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(PodStruct2), PodFlake);
+	TestEqual(TEXT("TestValueBack_PodFirst"), PodStruct2.First, PodStruct.First);
+	TestEqual(TEXT("TestValueBack_PodSecond"), PodStruct2.Second, PodStruct.Second);
+
+	FFlakesTestFloatArrayStruct FlatStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(FlatStruct2), FlatFlake);
+	TestEqual(TEXT("TestValueBack_Flat"), FlatStruct2.Values, FlatStruct.Values);
+
+	FFlakesTestCompoundStruct CompoundStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(CompoundStruct2), CompoundFlake);
+	FString Error;
+	if (!TestTrue(TEXT("TestValueBack_PodFastBinary"), CompoundStruct.Equals(CompoundStruct2, Error)))
+	{
+		AddInfo(Error);
+	}
+
+	// Same names and sizes, but different types, so the bytes must not be copied over.
+	AddExpectedError(TEXT("Pod payload was written with a different layout"), EAutomationExpectedErrorFlags::Contains, 1);
+	FFlakesTestRetypedPodStruct Retyped;
+	Flakes::WriteStruct(Backend, FStructView::Make(Retyped), PodFlake);
+	TestEqual(TEXT("Mismatched layout is not read"), Retyped.Second, 0);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesLazyFlakeTest,
+								 "Flakes.LazyFlake",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesLazyFlakeTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+
+	// The struct is copied, so changing it afterward doesn't change the flake.
+	FFlakesTestWrapperStruct TestStruct = FFlakesTestWrapperStruct::Rand();
+	const FFlakesTestWrapperStruct Original = TestStruct;
+	const Flakes::FLazyFlake LazyFlake(Backend, FConstStructView::Make(TestStruct));
+	TestStruct = FFlakesTestWrapperStruct::Rand();
+
+	TestFalse(TEXT("Not resolved before use"), LazyFlake.IsResolved());
+
+	FFlakesTestWrapperStruct TestStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(TestStruct2), LazyFlake);
+
+	TestTrue(TEXT("Resolved after use"), LazyFlake.IsResolved());
+
+	FString Result;
+	TestTrue(TEXT("TestValueBack_LazyStruct"), Original.Equals(TestStruct2, Result));
+
+	// Instanced structs can hold objects, which a copy wouldn't keep alive, so these are made right away.
+	const FFlakesTestCompoundStruct CompoundStruct = FFlakesTestCompoundStruct::Rand();
+	const Flakes::FLazyFlake EagerFlake(Backend, FConstStructView::Make(CompoundStruct));
+	TestTrue(TEXT("Struct with references is resolved immediately"), EagerFlake.IsResolved());
+
+	FFlakesTestCompoundStruct CompoundStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(CompoundStruct2), EagerFlake);
+	TestTrue(TEXT("TestValueBack_EagerStruct"), CompoundStruct.Equals(CompoundStruct2, Result));
+
+	// Objects are only referenced, so a change counter catches them being modified before the flake is made.
+	UFlakesTestSimpleObject* TestObject = UFlakesTestSimpleObject::New();
+	uint32 ChangeCount = 0;
+	const Flakes::FLazyFlake LazyObjectFlake(Backend, TestObject, [&ChangeCount] { return ChangeCount; });
+	TestFalse(TEXT("Not stale before changes"), LazyObjectFlake.IsStale());
+	++ChangeCount;
+	TestTrue(TEXT("Stale after changes"), LazyObjectFlake.IsStale());
+
+	// The modified state isn't what the flake was made for, so it's never captured.
+	AddExpectedError(TEXT("was modified before its flake was made"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestTrue(TEXT("Stale flake resolves empty"), LazyObjectFlake.Get().Data.IsEmpty());
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesSnapshotTest,
+								 "Flakes.AsyncSnapshot",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesSnapshotTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("FastBinary");
+	Flakes::FReadOptions ReadOps;
+	ReadOps.CompressionLevel = FOodleDataCompression::ECompressionLevel::None;
+
+	UFlakesTestComplexObject* TestObject = NewObject<UFlakesTestComplexObject>();
+	TestObject->ObjOwnedByUs = UFlakesTestSimpleObject::New(TestObject);
+	TestObject->TestSimpleObjectArray.Add(UFlakesTestSimpleObject::New(TestObject));
+
+	const FFlake FlakeFromObject = Flakes::MakeFlake(Backend, TestObject, ReadOps);
+
+	// The async flake is encoded from a snapshot, so changes made after it returns must not show up in it.
+	UE::Tasks::TTask<FFlake> Task = Flakes::MakeFlakeAsync(Backend, TestObject, ReadOps);
+	TestObject->ObjOwnedByUs->TestFloat += 1.f;
+	TestObject->TestSimpleObjectArray[0]->TestFloatArray.Empty();
+
+	TestTrue(TEXT("Snapshot matches the object when it was made"), Task.GetResult().Data == FlakeFromObject.Data);
+
+	// Pod falls back to FastBinary for objects, so it's encoded in the background too.
+	const FFlake PodFromObject = Flakes::MakeFlake(FName("Pod"), TestObject, ReadOps);
+	TestTrue(TEXT("Pod snapshot matches Pod"), Flakes::MakeFlakeAsync(FName("Pod"), TestObject, ReadOps).GetResult().Data == PodFromObject.Data);
+
+	// An object moved into the root after the snapshot was made is still only referenced, as it was when the snapshot
+	// was made, rather than exported without a copy.
+	UFlakesTestSimpleObject* External = UFlakesTestSimpleObject::New();
+	TestObject->TestSimpleObjectArray.Add(External);
+	const FFlake FlakeWithExternal = Flakes::MakeFlake(Backend, TestObject, ReadOps);
+
+	UE::Tasks::TTask<FFlake> MovedTask = Flakes::MakeFlakeAsync(Backend, TestObject, ReadOps);
+	External->Rename(nullptr, TestObject);
+
+	TestTrue(TEXT("Snapshot references objects as they were"), MovedTask.GetResult().Data == FlakeWithExternal.Data);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesDictionaryTest,
+								 "Flakes.Dictionary",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesDictionaryTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+	Flakes::FReadOptions ReadOps;
+	ReadOps.CompressionLevel = FOodleDataCompression::ECompressionLevel::None;
+
+	TArray<FFlake> Samples;
+	for (int32 i = 0; i < 16; ++i)
+	{
+		const FVector Sample(1.0, 2.0, i);
+		Samples.Add(Flakes::MakeFlake(Backend, FConstStructView::Make(Sample), nullptr, ReadOps));
+	}
+
+	const FFlakesDictionary Dictionary = Flakes::Dictionary::Train(FName("Vector"), Samples);
+	if (!TestTrue(TEXT("Dictionary is valid"), Dictionary.IsValid()))
+	{
+		return false;
+	}
+
+	const FVector TestVector(1.0, 2.0, 3.5);
+	Flakes::FReadOptions DictionaryReadOps;
+	DictionaryReadOps.Dictionary = &Dictionary;
+	const FFlake Flake = Flakes::MakeFlake(Backend, FConstStructView::Make(TestVector), nullptr, DictionaryReadOps);
+
+	TestEqual(TEXT("Flake records its dictionary"), Flake.Header.DictionaryId, Dictionary.Id);
+
+	// Registered dictionaries are found from the header, without being passed to the options.
+	FFlakesModule::Get().AddDictionary(Dictionary);
+	FVector TestVector2;
+	Flakes::WriteStruct(Backend, FStructView::Make(TestVector2), Flake);
+	TestEqual(TEXT("TestValueBack_Dictionary"), TestVector, TestVector2);
+
+	FFlakesModule::Get().RemoveDictionary(Dictionary.Id);
+	AddExpectedError(TEXT("Missing dictionary"), EAutomationExpectedErrorFlags::Contains, 1);
+	TArray<uint8> Buffer;
+	TConstArrayView<uint8> Raw;
+	TestFalse(TEXT("Unreadable without its dictionary"), Flakes::Private::DecompressFlake(Flake, Buffer, Raw, {}));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesChunkedCompressionTest,
+								 "Flakes.ChunkedCompression",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesChunkedCompressionTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+
+	// Lower the threshold, so a small object is split into several chunks.
+	Flakes::FReadOptions ReadOps;
+	ReadOps.ChunkedCompressionThreshold = 1;
+	ReadOps.ChunkSize = 256;
+
+	UFlakesTestSimpleObject* TestObject = UFlakesTestSimpleObject::New();
+	const FFlake Flake = Flakes::MakeFlake(Backend, TestObject, ReadOps);
+
+	TestEqual(TEXT("Flake is chunked"), Flake.Header.Codec, EFlakeCodec::OodleChunked);
+	TestTrue(TEXT("Flake has multiple chunks"), Flake.Header.Chunks.Num() > 1);
+
+	UFlakesTestSimpleObject* TestObject2 = Flakes::CreateObject<UFlakesTestSimpleObject>(Backend, Flake);
+
+	FString Error;
+	if (!TestTrue(TEXT("TestValueBack_Chunked"), TestObject->Equals(TestObject2, Error)))
+	{
+		AddInfo(Error);
+	}
+
+	// A chunk table that doesn't add up to the data must be rejected, rather than read past the end of it.
+	FFlake Corrupted = Flake;
+	Corrupted.Header.Chunks[0] += 1;
+
+	FFlake Truncated = Flake;
+	Truncated.Header.Chunks.Pop();
+
+	// Still adds up to the data, but the first chunk would start before it.
+	FFlake Negative = Flake;
+	Negative.Header.Chunks[1] += Negative.Header.Chunks[0] + 100;
+	Negative.Header.Chunks[0] = -100;
+
+	AddExpectedError(TEXT("DecompressFlake failed!"), EAutomationExpectedErrorFlags::Exact, 3);
+	TArray<uint8> Buffer;
+	TConstArrayView<uint8> Raw;
+	TestFalse(TEXT("Corrupted chunk table is rejected"), Flakes::Private::DecompressFlake(Corrupted, Buffer, Raw, {}));
+	TestFalse(TEXT("Truncated chunk table is rejected"), Flakes::Private::DecompressFlake(Truncated, Buffer, Raw, {}));
+	TestFalse(TEXT("Negative chunk size is rejected"), Flakes::Private::DecompressFlake(Negative, Buffer, Raw, {}));
+
+	// A size that doesn't fit in an array is rejected before anything is allocated.
+	FFlake Oversized = Flake;
+	Oversized.Header.UncompressedSize = static_cast<int64>(MAX_int32) + 1;
+
+	FFlake NegativeSize = Flake;
+	NegativeSize.Header.UncompressedSize = -1;
+
+	AddExpectedError(TEXT("Invalid uncompressed size"), EAutomationExpectedErrorFlags::Contains, 2);
+	TestFalse(TEXT("Oversized header is rejected"), Flakes::Private::DecompressFlake(Oversized, Buffer, Raw, {}));
+	TestFalse(TEXT("Negative size header is rejected"), Flakes::Private::DecompressFlake(NegativeSize, Buffer, Raw, {}));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesBatchTest,
+								 "Flakes.Batch",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesBatchTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+
+	TArray<FFlakesTestCompoundStruct> TestStructs;
+	TArray<FConstStructView> StructViews;
+	for (int32 i = 0; i < 8; ++i)
+	{
+		TestStructs.Add(FFlakesTestCompoundStruct::Rand());
+	}
+	for (const FFlakesTestCompoundStruct& TestStruct : TestStructs)
+	{
+		StructViews.Add(FConstStructView::Make(TestStruct));
+	}
+
+	const TArray<FFlake> StructFlakes = Flakes::MakeFlakes(Backend, StructViews);
+	if (TestEqual(TEXT("One flake per struct"), StructFlakes.Num(), TestStructs.Num()))
+	{
+		// Batched flakes are the same as ones made individually.
+		TestTrue(TEXT("Batched struct flake matches"),
+			StructFlakes[0].Data == Flakes::MakeFlake(Backend, StructViews[0]).Data);
+
+		const TArray<FInstancedStruct> Structs = Flakes::CreateStructs(Backend, StructFlakes, FFlakesTestCompoundStruct::StaticStruct());
+		for (int32 i = 0; i < TestStructs.Num(); ++i)
+		{
+			FString Error;
+			if (!TestTrue(TEXT("TestValueBack_BatchStruct"),
+					Structs[i].IsValid() && TestStructs[i].Equals(Structs[i].Get<FFlakesTestCompoundStruct>(), Error)))
+			{
+				AddInfo(Error);
+			}
+		}
+	}
+
+	TArray<const UObject*> TestObjects;
+	for (int32 i = 0; i < 8; ++i)
+	{
+		TestObjects.Add(UFlakesTestSimpleObject::New());
+	}
+
+	const TArray<FFlake> ObjectFlakes = Flakes::MakeFlakes(Backend, TestObjects);
+	if (TestEqual(TEXT("One flake per object"), ObjectFlakes.Num(), TestObjects.Num()))
+	{
+		const TArray<UObject*> Objects = Flakes::CreateObjects(Backend, ObjectFlakes, GetTransientPackage(), UFlakesTestSimpleObject::StaticClass());
+		for (int32 i = 0; i < TestObjects.Num(); ++i)
+		{
+			const UFlakesTestSimpleObject* Object = Cast<UFlakesTestSimpleObject>(Objects[i]);
+			if (!TestNotNull(TEXT("Batch object created"), Object))
+			{
+				continue;
+			}
+
+			FString Error;
+			if (!TestTrue(TEXT("TestValueBack_BatchObject"), CastChecked<UFlakesTestSimpleObject>(TestObjects[i])->Equals(Object, Error)))
+			{
+				AddInfo(Error);
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesAsyncTest,
+								 "Flakes.Async",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesAsyncTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+
+	// Making flakes only waits on background tasks, so these can be blocked on here.
+	const FFlakesTestCompoundStruct TestStruct = FFlakesTestCompoundStruct::Rand();
+	const FFlake StructFlake = Flakes::MakeFlakeAsync(Backend, FConstStructView::Make(TestStruct)).GetResult();
+	TestTrue(TEXT("Async struct flake matches"), StructFlake.Data == Flakes::MakeFlake(Backend, FConstStructView::Make(TestStruct)).Data);
+
+	const TStrongObjectPtr<UFlakesTestSimpleObject> TestObject(UFlakesTestSimpleObject::New());
+	const FFlake ObjectFlake = Flakes::MakeFlakeAsync(Backend, TestObject.Get()).GetResult();
+
+	UE::Tasks::TTask<FInstancedStruct> StructTask = Flakes::CreateStructAsync(Backend, StructFlake, FFlakesTestCompoundStruct::StaticStruct());
+	UE::Tasks::TTask<TStrongObjectPtr<UObject>> ObjectTask = Flakes::CreateObjectAsync(Backend, ObjectFlake, GetTransientPackage(), UFlakesTestSimpleObject::StaticClass());
+
+	// Creating them finishes on the game thread, so they are checked between frames instead.
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, TestStruct, TestObject, StructTask, ObjectTask]
+		{
+			if (!StructTask.IsCompleted() || !ObjectTask.IsCompleted())
+			{
+				return false;
+			}
+
+			// The created object has no references outside of the task, which must keep it alive until it's read.
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+			FString Error;
+			const FInstancedStruct& Struct = StructTask.GetResult();
+			if (!TestTrue(TEXT("TestValueBack_AsyncStruct"),
+					Struct.IsValid() && TestStruct.Equals(Struct.Get<FFlakesTestCompoundStruct>(), Error)))
+			{
+				AddInfo(Error);
+			}
+
+			const UFlakesTestSimpleObject* Object = Cast<UFlakesTestSimpleObject>(ObjectTask.GetResult().Get());
+			if (TestNotNull(TEXT("Async object created"), Object) &&
+				!TestTrue(TEXT("TestValueBack_AsyncObject"), TestObject->Equals(Object, Error)))
+			{
+				AddInfo(Error);
+			}
+
+			return true;
+		}));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesNameTableTest,
+								 "Flakes.NameTable",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesNameTableTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+	Flakes::FReadOptions ReadOps;
+	ReadOps.CompressionLevel = FOodleDataCompression::ECompressionLevel::None;
+
+	auto HasNameTable = [](const FFlake& Flake)
+		{
+			const Flakes::FRecursiveMemoryReader Reader(Flake.Data, false, nullptr);
+			return EnumHasAnyFlags(Reader.GetPayloadHeader().Flags, Flakes::FRecursivePayloadHeader::EFlags::NameTable);
+		};
+
+	auto TestObjectRoundTrip = [&](const TCHAR* What)
+		{
+			UFlakesTestSimpleObject* TestObject = UFlakesTestSimpleObject::New();
+			const FFlake Flake = Flakes::MakeFlake(Backend, TestObject, ReadOps);
+			UFlakesTestSimpleObject* TestObject2 = Flakes::CreateObject<UFlakesTestSimpleObject>(Backend, Flake);
+
+			FString Error;
+			if (!TestTrue(What, TestObject2 && TestObject->Equals(TestObject2, Error)))
+			{
+				AddInfo(Error);
+			}
+			return Flake;
+		};
+
+	// Tagged properties write their names, which go in the table.
+	TestTrue(TEXT("Object has a name table"), HasNameTable(TestObjectRoundTrip(TEXT("TestValueBack_NameTable"))));
+
+	// Payloads without any names, like a natively serialized guid, leave the table out entirely.
+	const FGuid TestGuid = FGuid::NewGuid();
+	const FFlake GuidFlake = Flakes::MakeFlake(Backend, FConstStructView::Make(TestGuid), nullptr, ReadOps);
+	TestFalse(TEXT("Guid has no name table"), HasNameTable(GuidFlake));
+	TestTrue(TEXT("TestValueBack_NoNameTable"), Flakes::CreateStruct<Flakes::Binary::Type, FGuid>(GuidFlake) == TestGuid);
+
+	// Names are written in full when interning is disabled.
+	IConsoleVariable* InternNames = IConsoleManager::Get().FindConsoleVariable(TEXT("flakes.InternNames"));
+	if (TestNotNull(TEXT("flakes.InternNames exists"), InternNames))
+	{
+		InternNames->Set(false);
+		TestFalse(TEXT("Name table disabled"), HasNameTable(TestObjectRoundTrip(TEXT("TestValueBack_NamesInline"))));
+		InternNames->Set(true);
+	}
+
+	// Payloads from before the header and table were added start directly with the tagged data.
+	const FFlakesTestWrapperStruct TestWrapper = FFlakesTestWrapperStruct::Rand();
+	FFlake LegacyFlake;
+	LegacyFlake.Struct = FFlakesTestWrapperStruct::StaticStruct();
+	{
+		FMemoryWriter LegacyWriter(LegacyFlake.Data);
+		FFlakesTestWrapperStruct::StaticStruct()->SerializeItem(LegacyWriter, const_cast<FFlakesTestWrapperStruct*>(&TestWrapper), nullptr);
+	}
+
+	Flakes::FWriteOptions LegacyWriteOps;
+	LegacyWriteOps.SkipDecompressionStep = true;
+	FFlakesTestWrapperStruct TestWrapper2;
+	Flakes::WriteStruct(Backend, FStructView::Make(TestWrapper2), LegacyFlake, nullptr, LegacyWriteOps);
+
+	FString Error;
+	if (!TestTrue(TEXT("TestValueBack_LegacyPayload"), TestWrapper.Equals(TestWrapper2, Error)))
+	{
+		AddInfo(Error);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesBulkArraysTest,
+								 "Flakes.BulkArrays",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesBulkArraysTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+
+	// The same struct, written from several threads at once, must be left as is, and produce the same payload each time.
+	FFlakesTestFloatArrayStruct TestStruct;
+	for (int32 i = 0; i < 256; ++i)
+	{
+		TestStruct.Values.Add(FMath::FRand());
+	}
+	const TArray<float> Values = TestStruct.Values;
+
+	TArray<FConstStructView> StructViews;
+	StructViews.Init(FConstStructView::Make(TestStruct), 16);
+	const TArray<FFlake> StructFlakes = Flakes::MakeFlakes(Backend, StructViews);
+
+	TestEqual(TEXT("Source array is untouched"), TestStruct.Values, Values);
+	for (const FFlake& Flake : StructFlakes)
+	{
+		TestEqual(TEXT("Payloads are identical"), Flake.Data, StructFlakes[0].Data);
+	}
+
+	FFlakesTestFloatArrayStruct TestStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(TestStruct2), StructFlakes[0]);
+	TestEqual(TEXT("TestValueBack_BulkArray"), TestStruct2.Values, Values);
+
+	// An alignment that isn't a power of two packs the blocks, rather than misaligning them.
+	IConsoleVariable* Alignment = IConsoleManager::Get().FindConsoleVariable(TEXT("flakes.BulkArrayAlignment"));
+	if (TestNotNull(TEXT("flakes.BulkArrayAlignment exists"), Alignment))
+	{
+		const int32 PreviousAlignment = Alignment->GetInt();
+		Alignment->Set(3);
+
+		UFlakesTestSimpleObject* TestObject = UFlakesTestSimpleObject::New();
+		UFlakesTestSimpleObject* TestObject2 = Flakes::CreateObject<UFlakesTestSimpleObject>(Backend, Flakes::MakeFlake(Backend, TestObject));
+
+		FString Error;
+		if (!TestTrue(TEXT("TestValueBack_UnalignedBulkArray"), TestObject2 && TestObject->Equals(TestObject2, Error)))
+		{
+			AddInfo(Error);
+		}
+
+		Alignment->Set(PreviousAlignment);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesJsonMapKeysTest,
+								 "Flakes.Json.MapKeys",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesJsonMapKeysTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Json");
+	Flakes::FReadOptions ReadOps;
+	ReadOps.CompressionLevel = FOodleDataCompression::ECompressionLevel::None;
+
+	FFlakesTestMapStruct TestStruct;
+	TestStruct.Names.Add(FName("Alpha"), 1);
+	TestStruct.Names.Add(FName("Beta"), 2);
+
+	const FFlake Flake = Flakes::MakeFlake(Backend, FConstStructView::Make(TestStruct), nullptr, ReadOps);
+
+	// Name keys are written in camelCase, the same as FJsonObjectConverter writes them.
+	const FUTF8ToTCHAR Json(reinterpret_cast<const UTF8CHAR*>(Flake.Data.GetData()), Flake.Data.Num());
+	const FString JsonString(Json.Length(), Json.Get());
+	TestTrue(TEXT("Name keys are standardized"), JsonString.Contains(TEXT("\"alpha\""), ESearchCase::CaseSensitive) &&
+		JsonString.Contains(TEXT("\"beta\""), ESearchCase::CaseSensitive));
+
+#if WITH_EDITORONLY_DATA
+	TestEqual(TEXT("Debug string is decoded from UTF-8"), Flake.DebugString, JsonString);
+#endif
+
+	FFlakesTestMapStruct TestStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(TestStruct2), Flake);
+	TestTrue(TEXT("TestValueBack_MapKeys"), TestStruct2.Names.OrderIndependentCompareEqual(TestStruct.Names));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesJsonUnicodeTest,
+								 "Flakes.Json.Unicode",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesJsonUnicodeTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Json");
+	Flakes::FReadOptions ReadOps;
+	ReadOps.CompressionLevel = FOodleDataCompression::ECompressionLevel::None;
+
+	// Characters outside of Latin-1, and outside of the BMP, which take a surrogate pair in UTF-16.
+	const FString Unicode = TEXT("\u00FC \u0416 \u20AC \U0001F600 \U0001D11E");
+
+	FFlakesTestTextStruct TestStruct;
+	TestStruct.String = Unicode;
+	TestStruct.Text = FText::AsCultureInvariant(Unicode);
+
+	const FFlake Flake = Flakes::MakeFlake(Backend, FConstStructView::Make(TestStruct), nullptr, ReadOps);
+
+	FString TextString;
+	FTextStringHelper::WriteToBuffer(TextString, TestStruct.Text);
+	const FString ExpectedJson = FString::Printf(TEXT("{\"string\":\"%s\",\"text\":\"%s\"}"),
+		*Unicode, *TextString.Replace(TEXT("\""), TEXT("\\\"")));
+
+	const FTCHARToUTF8 ExpectedUtf8(*ExpectedJson);
+	const TArray<uint8> ExpectedBytes(reinterpret_cast<const uint8*>(ExpectedUtf8.Get()), ExpectedUtf8.Length());
+	if (!TestTrue(TEXT("Payload is UTF-8"), Flake.Data == ExpectedBytes))
+	{
+		AddInfo(FString(FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(Flake.Data.GetData()), Flake.Data.Num())));
+	}
+
+	FFlakesTestTextStruct TestStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(TestStruct2), Flake);
+	TestEqual(TEXT("TestValueBack_String"), TestStruct2.String, Unicode);
+	TestEqual(TEXT("TestValueBack_Text"), TestStruct2.Text.ToString(), Unicode);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesJsonImportTest,
+								 "Flakes.Json.Import",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesJsonImportTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Json");
+
+	auto MakeJsonFlake = [](const UStruct* Struct, const TCHAR* Json)
+		{
+			FFlake Flake;
+			Flake.Struct = Struct;
+			const FTCHARToUTF8 Utf8(Json);
+			Flake.Data.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+			return Flake;
+		};
+
+	Flakes::FWriteOptions WriteOps;
+	WriteOps.SkipDecompressionStep = true;
+
+	// Objects owned through a struct member are created with the object that owns them as their outer.
+	UFlakesTestHolderObject* TestObject = NewObject<UFlakesTestHolderObject>();
+	TestObject->Holder.Object = UFlakesTestSimpleObject::New(TestObject);
+
+	UFlakesTestHolderObject* TestObject2 = Flakes::CreateObject<UFlakesTestHolderObject>(Backend, Flakes::MakeFlake(Backend, TestObject));
+	if (TestNotNull(TEXT("Holder was created"), TestObject2) &&
+		TestNotNull(TEXT("Object in struct was created"), TestObject2->Holder.Object.Get()))
+	{
+		TestTrue(TEXT("Object in struct is owned by the new holder"), TestObject2->Holder.Object->GetOuter() == TestObject2);
+
+		FString Error;
+		if (!TestTrue(TEXT("TestValueBack_ObjectInStruct"), TestObject->Holder.Object->Equals(TestObject2->Holder.Object, Error)))
+		{
+			AddInfo(Error);
+		}
+	}
+
+	// Repeated keys, even in a different case, replace the earlier value, like they would in an FJsonObject.
+	FFlakesTestMapStruct MapStruct;
+	Flakes::WriteStruct(Backend, FStructView::Make(MapStruct),
+		MakeJsonFlake(FFlakesTestMapStruct::StaticStruct(), TEXT("{\"Names\":{\"Alpha\":1,\"alpha\":2,\"Beta\":3}}")), nullptr, WriteOps);
+	TestEqual(TEXT("Repeated keys are merged"), MapStruct.Names.Num(), 2);
+	TestEqual(TEXT("Last repeated key wins"), MapStruct.Names.FindRef(FName("Alpha")), 2);
+
+	// Payloads written before json was stored as UTF-8 went through StringToBytes, and are still read.
+	const FString LegacyJson = TEXT("{\"Names\":{\"Gamma\":4}}");
+	FFlake LegacyFlake;
+	LegacyFlake.Struct = FFlakesTestMapStruct::StaticStruct();
+	LegacyFlake.Data.SetNumUninitialized(LegacyJson.Len());
+	StringToBytes(LegacyJson, LegacyFlake.Data.GetData(), LegacyFlake.Data.Num());
+	TestEqual(TEXT("Legacy payload starts with '|'"), static_cast<int32>(LegacyFlake.Data[0]), static_cast<int32>('|'));
+
+	FFlakesTestMapStruct LegacyStruct;
+	Flakes::WriteStruct(Backend, FStructView::Make(LegacyStruct), LegacyFlake, nullptr, WriteOps);
+	TestEqual(TEXT("TestValueBack_LegacyPayload"), LegacyStruct.Names.FindRef(FName("Gamma")), 4);
+
+	// Colors can be written in hex, and dates in ISO 8601.
+	FFlakesTestJsonStringsStruct StringsStruct;
+	Flakes::WriteStruct(Backend, FStructView::Make(StringsStruct),
+		MakeJsonFlake(FFlakesTestJsonStringsStruct::StaticStruct(),
+			TEXT("{\"Color\":\"FF000080\",\"LinearColor\":\"00FF00FF\",\"Date\":\"2024-01-02T03:04:05.000Z\"}")), nullptr, WriteOps);
+	TestTrue(TEXT("Color from hex"), StringsStruct.Color == FColor(255, 0, 0, 128));
+	TestTrue(TEXT("Linear color from hex"), StringsStruct.LinearColor == FLinearColor(0.f, 1.f, 0.f, 1.f));
+	TestTrue(TEXT("Date from ISO 8601"), StringsStruct.Date == FDateTime(2024, 1, 2, 3, 4, 5));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesJsonCborTest,
+								 "Flakes.Json.Cbor",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesJsonCborTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Json");
+
+	// The object is only known to the property as a UObject, so it has to be recreated from its class name.
+	UFlakesTestHolderObject* TestOuter = NewObject<UFlakesTestHolderObject>();
+	FFlakesTestCborStruct TestStruct;
+	TestStruct.BigInteger = (int64(1) << 40) + 7;
+	TestStruct.Number = 1.5f;
+	TestStruct.Bytes = { 0, 1, 127, 128, 255 };
+	TestStruct.Instanced.InitializeAs<FFlakesTestWrapperStruct>(FFlakesTestWrapperStruct::Rand());
+	TestStruct.Object = UFlakesTestSimpleObject::New(TestOuter);
+
+	const FFlake JsonFlake = Flakes::MakeFlake(Backend, FConstStructView::Make(TestStruct), TestOuter);
+
+	FFlake CborFlake;
+	if (!TestTrue(TEXT("Converted from json"), Flakes::Cbor::ConvertFromJson(JsonFlake, CborFlake)))
+	{
+		return false;
+	}
+	TestEqual(TEXT("Converted flake is Cbor"), CborFlake.Header.Provider, FName(Flakes::Cbor::Type::ProviderName));
+
+	FFlake JsonFlake2;
+	if (!TestTrue(TEXT("Converted back to json"), Flakes::Cbor::ConvertToJson(CborFlake, JsonFlake2)))
+	{
+		return false;
+	}
+
+	UFlakesTestHolderObject* TestOuter2 = NewObject<UFlakesTestHolderObject>();
+	FFlakesTestCborStruct TestStruct2;
+	Flakes::WriteStruct(Backend, FStructView::Make(TestStruct2), JsonFlake2, TestOuter2);
+
+	TestEqual(TEXT("TestValueBack_Int64"), TestStruct2.BigInteger, TestStruct.BigInteger);
+	TestEqual(TEXT("TestValueBack_Float"), TestStruct2.Number, TestStruct.Number);
+	TestTrue(TEXT("TestValueBack_Bytes"), TestStruct2.Bytes == TestStruct.Bytes);
+	TestTrue(TEXT("TestValueBack_StructName"), TestStruct2.Instanced == TestStruct.Instanced);
+
+	const UFlakesTestSimpleObject* Object2 = Cast<UFlakesTestSimpleObject>(TestStruct2.Object);
+	if (TestNotNull(TEXT("TestValueBack_ClassName"), Object2))
+	{
+		FString Error;
+		if (!TestTrue(TEXT("TestValueBack_Object"), CastChecked<UFlakesTestSimpleObject>(TestStruct.Object)->Equals(Object2, Error)))
+		{
+			AddInfo(Error);
+		}
+	}
+
+	// Flakes from before the provider was stored have no header, and were compressed, and encoded with StringToBytes.
+	const FString LegacyJson = TEXT("{\"number\":2.5}");
+	TArray<uint8> LegacyRaw;
+	LegacyRaw.SetNumUninitialized(LegacyJson.Len());
+	StringToBytes(LegacyJson, LegacyRaw.GetData(), LegacyRaw.Num());
+
+	FFlake LegacyFlake;
+	LegacyFlake.Struct = FFlakesTestCborStruct::StaticStruct();
+	FOodleCompressedArray::CompressTArray(LegacyFlake.Data, LegacyRaw,
+		FOodleDataCompression::ECompressor::Kraken, FOodleDataCompression::ECompressionLevel::Normal);
+
+	FFlake LegacyCborFlake;
+	if (TestTrue(TEXT("Converted flake without a header"), Flakes::Cbor::ConvertFromJson(LegacyFlake, LegacyCborFlake)))
+	{
+		FFlakesTestCborStruct LegacyStruct;
+		Flakes::WriteStruct(FName(Flakes::Cbor::Type::ProviderName), FStructView::Make(LegacyStruct), LegacyCborFlake);
+		TestEqual(TEXT("TestValueBack_Legacy"), LegacyStruct.Number, 2.5f);
+	}
+
+	// Half-precision floats aren't written by Flakes, but other encoders use them for small values.
+	Flakes::FWriteOptions WriteOps;
+	WriteOps.SkipDecompressionStep = true;
+
+	FFlake HalfFlake;
+	HalfFlake.Struct = FFlakesTestCborStruct::StaticStruct();
+	HalfFlake.Header.Provider = Flakes::Cbor::Type::ProviderName;
+	const uint8 HalfPayload[] = { 0xBF, 0x66, 'n', 'u', 'm', 'b', 'e', 'r', 0xF9, 0x3E, 0x00, 0xFF };
+	HalfFlake.Data.Append(HalfPayload, UE_ARRAY_COUNT(HalfPayload));
+
+	FFlakesTestCborStruct HalfStruct;
+	Flakes::WriteStruct(FName(Flakes::Cbor::Type::ProviderName), FStructView::Make(HalfStruct), HalfFlake, nullptr, WriteOps);
+	TestEqual(TEXT("TestValueBack_HalfFloat"), HalfStruct.Number, 1.5f);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesDependenciesTest,
+								 "Flakes.Dependencies",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesDependenciesTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+
+	// An object we don't own is written as a path, and each reference to it must resolve back to it.
+	UFlakesTestSimpleObject* External = UFlakesTestSimpleObject::New();
+	UFlakesTestComplexObject* TestObject = NewObject<UFlakesTestComplexObject>();
+	TestObject->ObjOwnedByUs = UFlakesTestSimpleObject::New(TestObject);
+	TestObject->TestSimpleObjectArray.Add(External);
+	TestObject->TestSimpleObjectArray.Add(External);
+
+	const FFlake Flake = Flakes::MakeFlake(Backend, TestObject);
+
+	{
+		// Gathering only reads the table, so it must not register with a scope the caller is in.
+		Flakes::Private::FCreatedObjectsScope Scope;
+
+		TArray<FSoftObjectPath> Paths;
+		Flakes::GatherDependencies(Flake, Paths);
+
+		TestTrue(TEXT("Own class is a dependency"), Paths.Contains(FSoftObjectPath(UFlakesTestComplexObject::StaticClass())));
+		TestTrue(TEXT("Subobject class is a dependency"), Paths.Contains(FSoftObjectPath(UFlakesTestSimpleObject::StaticClass())));
+		TestTrue(TEXT("Referenced object is a dependency"), Paths.Contains(FSoftObjectPath(External)));
+		TestNull(TEXT("Gathering records nothing"), Scope.GetCreatedObjects());
+	}
+
+	// Everything is already in memory, so the callback runs right away, without a load.
+	bool Loaded = false;
+	const TSharedPtr<FStreamableHandle> Handle = Flakes::PreloadDependencies(Flake, [&Loaded] { Loaded = true; });
+	TestFalse(TEXT("Nothing to load"), Handle.IsValid());
+	TestTrue(TEXT("Loaded callback ran"), Loaded);
+
+	UFlakesTestComplexObject* TestObject2 = Flakes::CreateObject<UFlakesTestComplexObject>(Backend, Flake);
+	if (TestNotNull(TEXT("Object created"), TestObject2) &&
+		TestEqual(TEXT("Array restored"), TestObject2->TestSimpleObjectArray.Num(), 2))
+	{
+		TestTrue(TEXT("First reference resolved"), TestObject2->TestSimpleObjectArray[0] == External);
+		TestTrue(TEXT("Cached reference resolved"), TestObject2->TestSimpleObjectArray[1] == External);
+	}
+
+	return true;
+}
+
+namespace Flakes::Tests
+{
+	// Hands out the objects it was given, and keeps whatever is released back to it.
+	struct FTestObjectPool : IObjectPool
+	{
+		TArray<UObject*> Free;
+		TArray<UObject*> Released;
+
+		virtual UObject* Acquire(const UClass* Class, UObject* Outer) override
+		{
+			const int32 Index = Free.IndexOfByPredicate([Class](const UObject* Object) { return Object->GetClass() == Class; });
+			return Index != INDEX_NONE ? Free[Index] : nullptr;
+		}
+
+		virtual bool Release(UObject* Object) override
+		{
+			Released.Add(Object);
+			return true;
+		}
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesObjectPoolTest,
+								 "Flakes.ObjectPool",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesObjectPoolTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+
+	UFlakesTestComplexObject* TestObject = NewObject<UFlakesTestComplexObject>();
+	TestObject->ObjOwnedByUs = UFlakesTestSimpleObject::New(TestObject);
+	TestObject->TestSimpleObjectArray.Add(UFlakesTestSimpleObject::New(TestObject));
+	const FFlake Flake = Flakes::MakeFlake(Backend, TestObject);
+
+	// A pooled object still holding the subobject it was last read into.
+	UFlakesTestComplexObject* Pooled = NewObject<UFlakesTestComplexObject>();
+	UFlakesTestSimpleObject* PooledSubobject = UFlakesTestSimpleObject::New(Pooled);
+	Pooled->ObjOwnedByUs = PooledSubobject;
+
+	Flakes::Tests::FTestObjectPool Pool;
+	Pool.Free.Add(Pooled);
+
+	Flakes::FWriteOptions WriteOps = Flakes::CreationDefault;
+	WriteOps.ObjectPool = &Pool;
+	UFlakesTestComplexObject* TestObject2 = Flakes::CreateObject<UFlakesTestComplexObject>(Backend, Flake, GetTransientPackage(), WriteOps);
+
+	TestTrue(TEXT("Pooled object is used"), TestObject2 == Pooled);
+	if (TestNotNull(TEXT("Object created"), TestObject2))
+	{
+		// Resetting the pooled object must keep its owned subobject, so the reader can reuse it.
+		TestTrue(TEXT("Owned subobject is reused"), TestObject2->ObjOwnedByUs == PooledSubobject);
+
+		FString Error;
+		if (!TestTrue(TEXT("TestValueBack_Pooled"), TestObject->Equals(TestObject2, Error)))
+		{
+			AddInfo(Error);
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FlakesReconcileTest,
+								 "Flakes.Reconcile",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FlakesReconcileTest::RunTest(const FString& Parameters)
+{
+	const FName Backend = FName("Binary");
+
+	UFlakesTestComplexObject* TestObject = NewObject<UFlakesTestComplexObject>();
+	TestObject->ObjOwnedByUs = UFlakesTestSimpleObject::New(TestObject);
+	TestObject->TestSimpleObjectArray.Add(UFlakesTestSimpleObject::New(TestObject));
+	const FFlake Flake = Flakes::MakeFlake(Backend, TestObject);
+
+	// An existing object to restore into, with more subobjects in its array than the flake has.
+	UFlakesTestComplexObject* Target = NewObject<UFlakesTestComplexObject>();
+	UFlakesTestSimpleObject* Owned = UFlakesTestSimpleObject::New(Target);
+	UFlakesTestSimpleObject* Stale1 = UFlakesTestSimpleObject::New(Target);
+	UFlakesTestSimpleObject* Stale2 = UFlakesTestSimpleObject::New(Target);
+	Target->ObjOwnedByUs = Owned;
+	Target->TestSimpleObjectArray = { Stale1, Stale2 };
+
+	Flakes::Tests::FTestObjectPool Pool;
+	Flakes::FWriteOptions WriteOps;
+	WriteOps.ReconcileSubobjects = true;
+	WriteOps.ObjectPool = &Pool;
+	Flakes::WriteObject(Backend, Target, Flake, WriteOps);
+
+	TestTrue(TEXT("Owned subobject is reused"), Target->ObjOwnedByUs == Owned);
+	TestFalse(TEXT("Reused subobject is not released"), Pool.Released.Contains(Owned));
+
+	// Subobjects that were only in the array are no longer in use, even though the array never reports replacing them.
+	TestTrue(TEXT("Stale array subobject is released"), Pool.Released.Contains(Stale1));
+	TestTrue(TEXT("Other stale array subobject is released"), Pool.Released.Contains(Stale2));
+
+	FString Error;
+	if (!TestTrue(TEXT("TestValueBack_Reconciled"), TestObject->Equals(Target, Error)))
+	{
+		AddInfo(Error);
+	}
+
 	return true;
 }
\ No newline at end of file